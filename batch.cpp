@@ -0,0 +1,288 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include "batch.h"
+#include "instrument.h"
+
+using namespace std;
+
+bool readManifest(string path, vector<BatchJob>& jobs) {
+  ifstream manifest(path);
+  if (!manifest.is_open()) {
+    cout << "Error: failed to open manifest - " << path << endl;
+    return false;
+  }
+
+  string line;
+  int lineNumber = 0;
+  while (getline(manifest, line)) {
+    ++lineNumber;
+    //drop comments, skip blank lines
+    size_t comment = line.find('#');
+    if (comment != string::npos) {
+      line.erase(comment);
+    }
+    stringstream fields(line);
+    BatchJob job = { "", 0, 0, "" };
+    if (!(fields >> job.input)) {
+      continue;
+    }
+    string extra;
+    if (!(fields >> job.targetWidth >> job.targetHeight >> job.output) || (fields >> extra)) {
+      cout << "Error: manifest line " << lineNumber << " should be: input targetWidth targetHeight output" << endl;
+      return false;
+    }
+    if (job.targetWidth <= 0 || job.targetHeight <= 0) {
+      cout << "Error: manifest line " << lineNumber << " has a target size that isn't greater than 0" << endl;
+      return false;
+    }
+    jobs.push_back(job);
+  }
+  return true;
+}
+
+//"640" or "50%": a whole number greater than 0, and a percentage at most 100
+static bool parseTarget(const string& target, const string& name, long& value, bool& percent) {
+  percent = !target.empty() && target.back() == '%';
+  string digits = percent ? target.substr(0, target.size() - 1) : target;
+  char* end = nullptr;
+  errno = 0;
+  value = strtol(digits.c_str(), &end, 10);
+  if (digits.empty() || *end != '\0' || errno == ERANGE || value > INT_MAX) {
+    cout << "Error: target " << name << " " << target << " isn't a whole number or percentage" << endl;
+    return false;
+  }
+  if (value <= 0) {
+    cout << "Error: target " << name << " " << target << " isn't greater than 0" << endl;
+    return false;
+  }
+  if (percent && value > 100) {
+    cout << "Error: target " << name << " " << target << " is more than 100%" << endl;
+    return false;
+  }
+  return true;
+}
+
+//640 stays 640, 50% becomes half of original
+static int resolveTarget(long value, bool percent, int original) {
+  if (percent) {
+    return max(1, static_cast<int>(static_cast<long long>(original) * value / 100));
+  }
+  return static_cast<int>(value);
+}
+
+bool listDirectory(string directory, string targetWidth, string targetHeight, string outputDirectory, vector<BatchJob>& jobs) {
+  long widthValue, heightValue;
+  bool widthPercent, heightPercent;
+  if (!parseTarget(targetWidth, "width", widthValue, widthPercent) || !parseTarget(targetHeight, "height", heightValue, heightPercent)) {
+    return false;
+  }
+
+  error_code error;
+  vector<filesystem::path> inputs;
+  for (const filesystem::directory_entry& entry : filesystem::directory_iterator(directory, error)) {
+    string extension = entry.path().extension().string();
+    if (entry.is_regular_file() && (extension == ".ppm" || extension == ".pnm")) {
+      inputs.push_back(entry.path());
+    }
+  }
+  if (error) {
+    cout << "Error: failed to read directory - " << directory << endl;
+    return false;
+  }
+  filesystem::create_directories(outputDirectory, error);
+  if (error) {
+    cout << "Error: failed to create output directory - " << outputDirectory << endl;
+    return false;
+  }
+  sort(inputs.begin(), inputs.end());
+
+  for (const filesystem::path& input : inputs) {
+    //sizes come from each file's header, so percentages can be resolved up front
+    int width, height;
+    if (!loadImageHeader(input.string(), width, height)) {
+      continue;
+    }
+    BatchJob job = { input.string(), resolveTarget(widthValue, widthPercent, width), resolveTarget(heightValue, heightPercent, height), "" };
+    stringstream name;
+    name << "carved" << job.targetWidth << "X" << job.targetHeight << "." << input.filename().string();
+    job.output = (filesystem::path(outputDirectory) / name.str()).string();
+    jobs.push_back(job);
+  }
+  return true;
+}
+
+//counting semaphore over megabytes, so the images being carved at once stay under the budget
+//a job bigger than the whole budget still runs, but only on its own
+class MemoryBudget {
+ public:
+  explicit MemoryBudget(long long limit) : lock(), released(), limit(limit), used(0) {}
+
+  void acquire(long long amount) {
+    unique_lock<mutex> guard(lock);
+    released.wait(guard, [&]() { return used == 0 || used + amount <= limit; });
+    used += amount;
+  }
+
+  void release(long long amount) {
+    {
+      lock_guard<mutex> guard(lock);
+      used -= amount;
+    }
+    released.notify_all();
+  }
+
+ private:
+  mutex lock;
+  condition_variable released;
+  long long limit;
+  long long used;
+};
+
+//peak memory of one carve: the image plus the energy map, cost table and transposed copies.
+//The optimal order adds an image and an energy map per column removed and its table of
+//(rows + 1) x (columns + 1) energies; jobs over the whole budget still run, one at a time
+static long long estimateMB(int width, int height, const BatchJob& job, const BatchOptions& options) {
+  long long pixels = static_cast<long long>(width + 15) * height;
+  long long bytes = pixels * (2 * sizeof(Pixel) + 2 * sizeof(int) + sizeof(long long));
+  if (options.seamsPerPass == 1 && options.order == ORDER_OPTIMAL) {
+    long long cols = max(0, width - job.targetWidth);
+    long long rows = max(0, height - job.targetHeight);
+    bytes += (cols + 1) * pixels * (sizeof(Pixel) + sizeof(int)) + (rows + 1) * (cols + 1) * sizeof(long long);
+  }
+  return bytes / (1 << 20) + 1;
+}
+
+//load, carve and save one job whose header gave width x height (0 x 0 if it couldn't be read)
+//status gets the line to report for it, context is the worker's
+static bool carveJob(const BatchJob& job, int width, int height, const BatchOptions& options, CarveContext* context, string& status) {
+  //one span per image in the trace, on the worker that carved it
+  PROFILE_TASK(job.input);
+  stringstream line;
+  line << job.input << " -> " << job.output;
+
+  if (width <= 0 || height <= 0) {
+    status = line.str() + ": FAILED (bad header)";
+    return false;
+  }
+  line << " " << width << "x" << height << " -> " << job.targetWidth << "x" << job.targetHeight;
+  if (job.targetWidth > width || job.targetHeight > height) {
+    status = line.str() + ": FAILED (target is bigger than the image)";
+    return false;
+  }
+
+  Image* image = createImage(width, height);
+  if (image == nullptr || !loadImage(job.input, image)) {
+    deleteImage(image);
+    status = line.str() + ": FAILED (load)";
+    return false;
+  }
+
+  //a repeat of an earlier request is copied out of the cache instead of carved
+  unsigned long long pixelHash = 0;
+  string key;
+  bool cached = false;
+  if (options.cache != nullptr) {
+    pixelHash = hashImage(image);
+    key = cacheKey(pixelHash, width, height, job.targetWidth, job.targetHeight, options.cacheParameters);
+    cached = cacheLookup(options.cache, key, image);
+  }
+
+  if (cached) {
+    line << " (cached)";
+  }
+  else if (options.seamsPerPass != 1) {
+    carveVerticalSeams(image, job.targetWidth, options.seamsPerPass, options.search);
+    carveHorizontalSeams(image, job.targetHeight, options.seamsPerPass, options.search);
+  }
+  else {
+    //the greedy order can start from the energies of an earlier carve of the same pixels
+    EnergyMap* seed = nullptr;
+    if (options.cache != nullptr && cacheKeepsEnergies(options.cache) && options.order == ORDER_GREEDY) {
+      string seedKey = energyKey(pixelHash, width, height, "dual");
+      seed = cacheLookupEnergies(options.cache, seedKey);
+      if (seed == nullptr && (seed = createEnergyMap(image)) != nullptr) {
+        cacheStoreEnergies(options.cache, seedKey, seed);
+      }
+      seedEnergies(context, image, seed);
+    }
+    retargetImage(image, job.targetWidth, job.targetHeight, options.order, options.search, context);
+    seedEnergies(context, nullptr, nullptr);
+    deleteEnergyMap(seed);
+  }
+  if (options.cache != nullptr && !cached) {
+    cacheStore(options.cache, key, image);
+  }
+
+  bool ok = outputImage(job.output, image, options.format);
+  deleteImage(image);
+  status = line.str() + (ok ? ": ok" : ": FAILED (write)");
+  return ok;
+}
+
+BatchSummary runBatch(const vector<BatchJob>& jobs, const BatchOptions& options) {
+  BatchSummary summary = { 0, 0, 0.0 };
+  auto start = chrono::steady_clock::now();
+
+  setVerbose(false);
+
+  int workers = options.workers > 0 ? options.workers : static_cast<int>(max(1u, thread::hardware_concurrency()));
+  workers = min(workers, max(1, static_cast<int>(jobs.size())));
+  MemoryBudget budget(max(1LL, options.memoryMB));
+  atomic<size_t> next(0);
+  mutex printLock;
+
+  //each worker reuses one carving context for all of its images; it holds on to the buffers
+  //of the biggest image so far, which that image's share of the budget already covered
+  //parallelism comes from carving several images at once, each one stays on its worker; the
+  //thread count is the workers' own, so other carves in the process keep theirs
+  auto worker = [&]() {
+    setThreadCountOnThisThread(1);
+    CarveContext* context = createCarveContext();
+    size_t index;
+    while ((index = next++) < jobs.size()) {
+      const BatchJob& job = jobs[index];
+      int width = 0, height = 0;
+      long long needed = loadImageHeader(job.input, width, height) ? estimateMB(width, height, job, options) : 1;
+
+      budget.acquire(needed);
+      auto jobStart = chrono::steady_clock::now();
+      string status;
+      bool ok = carveJob(job, width, height, options, context, status);
+      double seconds = chrono::duration<double>(chrono::steady_clock::now() - jobStart).count();
+      budget.release(needed);
+
+      lock_guard<mutex> guard(printLock);
+      (ok ? summary.succeeded : summary.failed) += 1;
+      cout << "[" << index + 1 << "/" << jobs.size() << "] " << status << " (" << seconds << " s)" << endl;
+    }
+    deleteCarveContext(context);
+  };
+
+  vector<thread> pool;
+  for (int i = 0; i < workers; ++i) {
+    pool.emplace_back(worker);
+  }
+  for (thread& t : pool) {
+    t.join();
+  }
+
+  setVerbose(true);
+
+  summary.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << "Processed " << jobs.size() << " images (" << summary.succeeded << " ok, " << summary.failed << " failed) in "
+       << summary.seconds << " s, " << (summary.seconds > 0 ? jobs.size() / summary.seconds : 0.0) << " images/s" << endl;
+  return summary;
+}
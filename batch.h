@@ -0,0 +1,44 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+#include "functions.h"
+#include "resultcache.h"
+
+// one image to carve: where it comes from, how big it should end up, where it goes
+struct BatchJob {
+  std::string input;
+  int targetWidth;
+  int targetHeight;
+  std::string output;
+};
+
+struct BatchOptions {
+  int workers;          // images carved at the same time (0 = one per core)
+  long long memoryMB;   // rough cap on the memory of the images in flight
+  int seamsPerPass;     // same meaning as in carveVerticalSeams
+  SeamOrder order;      // order used when seamsPerPass == 1
+  SeamMode search;      // SEAM_DP or SEAM_PYRAMID for one-at-a-time seams
+  PpmFormat format;     // output encoding
+  ResultCache* cache;   // finished results (and energy maps) to reuse, nullptr = none
+  std::string cacheParameters;  // what else the cache key must hold, e.g. the pyramid settings
+};
+
+struct BatchSummary {
+  int succeeded;
+  int failed;
+  double seconds;
+};
+
+// manifest: one "input targetWidth targetHeight output" per line, # starts a comment
+bool readManifest(std::string path, std::vector<BatchJob>& jobs);
+// every .ppm/.pnm file in directory, carved to the same target and written to outputDirectory
+// a target is a size greater than 0, or ending in % a percentage (1-100) of each image's own
+// size; false, with an error printed, for any other target or a directory that can't be used
+bool listDirectory(std::string directory, std::string targetWidth, std::string targetHeight,
+                   std::string outputDirectory, std::vector<BatchJob>& jobs);
+// carve every job on a pool of worker threads, printing one status line per image
+BatchSummary runBatch(const std::vector<BatchJob>& jobs, const BatchOptions& options);
+
+#endif
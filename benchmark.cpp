@@ -0,0 +1,344 @@
+// compile command:  g++ -std=c++17 -O2 -pthread functions.cpp instrument.cpp pixelformat.cpp energypolicy.cpp lazyimage.cpp benchmark.cpp -o benchmark
+// usage: ./benchmark [--sizes 64x64,512x512,...] [--contents noise,gradient,flat] [--json out.json] [--label name] [--min-time s]
+
+/*
+- synthetic images are generated in memory, nothing is read from disk except the PPM I/O stages
+- every stage runs until it has used at least --min-time seconds and reports the mean time per call
+- ns/pixel is relative to the pixels the stage touches, seams/s is reported for stages that remove seams
+- carve-full-cost vs carve-incremental-cost is the cost table refilled for every seam vs updated in place;
+  the update's gain depends on width, e.g. --sizes 256x256,1024x256,4096x256
+- results go to stdout as a table and, with --json, to a machine-readable file that can be diffed between versions
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+#include "functions.h"
+#include "pixelformat.h"
+#include "energypolicy.h"
+#include "lazyimage.h"
+#include "instrument.h"
+
+using namespace std;
+
+struct BenchmarkResult {
+  string size;
+  string content;
+  string stage;
+  double secondsPerCall;
+  double nsPerPixel;
+  double seamsPerSecond; // 0 when the stage doesn't remove seams
+  double energyVsExact;  // relative difference in removed energy against the exact DP, pyramid stage only
+};
+
+static double minimumSeconds = 0.25;
+
+//mean seconds per call of work(), after one warm-up call
+static double measure(const function<void()>& work) {
+  work();
+  int calls = 0;
+  auto start = chrono::steady_clock::now();
+  double elapsed = 0;
+  do {
+    work();
+    ++calls;
+    elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  } while (elapsed < minimumSeconds);
+  return elapsed / calls;
+}
+
+//deterministic synthetic content so runs on different versions see the same pixels
+static void fillImage(Image* image, const string& content) {
+  unsigned state = 12345;
+  for (int row = 0; row < image->height; ++row) {
+    Pixel* line = imageRow(image, row);
+    for (int col = 0; col < image->width; ++col) {
+      if (content == "noise") {
+        state = state * 1103515245 + 12345;
+        line[col] = { static_cast<int>((state >> 8) & 255), static_cast<int>((state >> 16) & 255), static_cast<int>((state >> 24) & 255) };
+      }
+      else if (content == "gradient") {
+        line[col] = { col * 255 / max(1, image->width - 1), row * 255 / max(1, image->height - 1), (col + row) % 256 };
+      }
+      else {
+        line[col] = { 128, 128, 128 };
+      }
+    }
+  }
+}
+
+static vector<string> split(const string& text) {
+  vector<string> parts;
+  stringstream stream(text);
+  string part;
+  while (getline(stream, part, ',')) {
+    parts.push_back(part);
+  }
+  return parts;
+}
+
+static const char* backendName(EnergyBackend backend) {
+  return backend == ENERGY_AVX2 ? "avx2" : backend == ENERGY_SSE4 ? "sse4" : "scalar";
+}
+
+static void writeJson(const string& path, const string& label, const vector<BenchmarkResult>& results) {
+  ofstream out(path);
+  out << "{\n  \"label\": " << jsonString(label) << ",\n  \"threads\": " << threadCount()
+      << ",\n  \"energy_backend\": \"" << backendName(energyBackend()) << "\",\n  \"results\": [\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchmarkResult& result = results[i];
+    out << "    {\"size\": " << jsonString(result.size) << ", \"content\": " << jsonString(result.content) << ", \"stage\": " << jsonString(result.stage)
+        << ", \"seconds_per_call\": " << result.secondsPerCall << ", \"ns_per_pixel\": " << result.nsPerPixel
+        << ", \"seams_per_second\": " << result.seamsPerSecond << ", \"energy_vs_exact\": " << result.energyVsExact << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  out << "  ]\n}\n";
+}
+
+//exact carve of a compact copy of image down to targetWidth, conversion included
+template <class T>
+static void carveFormat(const Image* image, int targetWidth) {
+  BasicImage<T>* compact = convertImage<T>(image);
+  carveVerticalSeams(compact, targetWidth);
+  deleteBasicImage(compact);
+}
+
+//full energy map and an exact carve of seams columns with one energy policy
+template <class Energy, class Record>
+static void benchmarkPolicy(const Record& record, const Image* original, Image* work, int seams, double pixels) {
+  string name = Energy::name();
+  record("energy-map-" + name, measure([&]() {
+    deleteEnergyMap(createEnergyMap<Energy>(original));
+  }), pixels, 0);
+  CarveContext* context = createCarveContext();
+  record("carve-" + name, measure([&]() {
+    copyImage(original, work);
+    carveVerticalSeams<Energy>(work, original->width - seams, context);
+  }), pixels * seams, seams);
+  deleteCarveContext(context);
+}
+
+int main(int argc, char* argv[]) {
+  string sizes = "64x64,512x512,1920x1080,7680x4320";
+  string contents = "noise,gradient,flat";
+  string jsonPath;
+  string label = "benchmark";
+  for (int i = 1; i < argc; ++i) {
+    string option = argv[i];
+    if (option == "--sizes" && i + 1 < argc) {
+      sizes = argv[++i];
+    }
+    else if (option == "--contents" && i + 1 < argc) {
+      contents = argv[++i];
+    }
+    else if (option == "--json" && i + 1 < argc) {
+      jsonPath = argv[++i];
+    }
+    else if (option == "--label" && i + 1 < argc) {
+      label = argv[++i];
+    }
+    else if (option == "--min-time" && i + 1 < argc) {
+      minimumSeconds = atof(argv[++i]);
+    }
+    else if (option == "--threads" && i + 1 < argc) {
+      setThreadCount(atoi(argv[++i]));
+    }
+    else if (option == "--pyramid" && i + 2 < argc) {
+      setPyramid(atoi(argv[i + 1]), atoi(argv[i + 2]));
+      i += 2;
+    }
+    else {
+      cout << "Usage: " << argv[0] << " [--sizes WxH,...] [--contents noise,gradient,flat] [--json FILE] [--label NAME] [--min-time S] [--threads N] [--pyramid LEVELS BAND]" << endl;
+      return 1;
+    }
+  }
+
+  setVerbose(false);
+  vector<BenchmarkResult> results;
+  string scratchFile = "/tmp/seamcarving_benchmark_" + to_string(getpid());
+
+  for (const string& size : split(sizes)) {
+    int width = 0, height = 0;
+    if (sscanf(size.c_str(), "%dx%d", &width, &height) != 2 || width < 3 || height < 3) {
+      cout << "Error: bad size " << size << endl;
+      return 1;
+    }
+    double pixels = static_cast<double>(width) * height;
+
+    for (const string& content : split(contents)) {
+      Image* original = createImage(width, height);
+      Image* work = createImage(width, height);
+      if (original == nullptr || work == nullptr) {
+        cout << "Error: not enough memory for " << size << endl;
+        return 1;
+      }
+      fillImage(original, content);
+      copyImage(original, work);
+      EnergyMap* energies = createEnergyMap(original);
+
+      auto record = [&](const string& stage, double seconds, double touched, double seams, double energyVsExact = 0.0) {
+        BenchmarkResult result = { size, content, stage, seconds, seconds * 1e9 / touched, seams > 0 ? seams / seconds : 0.0, energyVsExact };
+        results.push_back(result);
+        printf("%-11s %-9s %-27s %12.3f ms %10.3f ns/px", size.c_str(), content.c_str(), stage.c_str(), seconds * 1e3, result.nsPerPixel);
+        if (seams > 0) {
+          printf(" %10.1f seams/s", result.seamsPerSecond);
+        }
+        if (energyVsExact != 0.0) {
+          printf(" %+8.3f%% energy", 100.0 * energyVsExact);
+        }
+        printf("\n");
+        fflush(stdout);
+      };
+
+      //a single row of the image through energy(), one pixel at a time
+      volatile int sink = 0;
+      record("energy", measure([&]() {
+        int total = 0;
+        for (int col = 0; col < width; ++col) {
+          total += energy(original, col, height / 2);
+        }
+        sink = total;
+      }), width, 0);
+      record("computeEnergyRow", measure([&]() {
+        computeEnergyRow(original, height / 2, energyMapRow(energies, height / 2));
+      }), width, 0);
+      record("createEnergyMap", measure([&]() {
+        deleteEnergyMap(createEnergyMap(original));
+      }), pixels, 0);
+
+      vector<int> seam(height);
+      record("loadVerticalSeam", measure([&]() {
+        sink = loadVerticalSeam(original, width / 2, seam.data());
+      }), height, 0);
+      record("findMinVerticalSeam", measure([&]() {
+        deleteSeam(findMinVerticalSeam(original, SEAM_DP, energies));
+      }), pixels, 1);
+      //the greedy search tries every start column, only worth timing on small images
+      if (pixels <= 512.0 * 512.0) {
+        record("findMinVerticalSeam-greedy", measure([&]() {
+          deleteSeam(findMinVerticalSeam(original, SEAM_GREEDY));
+        }), pixels, 1);
+      }
+
+      //removal only: a straight seam down the middle, on an image that is refreshed every 64
+      //calls, or before half its columns are gone on narrow sizes
+      int removals = 0;
+      int refreshEvery = min(64, width / 2);
+      record("removeVerticalSeam", measure([&]() {
+        if (removals++ % refreshEvery == 0) {
+          copyImage(original, work);
+        }
+        for (int row = 0; row < height; ++row) {
+          seam[row] = work->width / 2;
+        }
+        removeVerticalSeam(work, seam.data());
+      }), pixels, 1);
+
+      //whole carves: remove 5% of the columns one exact seam at a time, then adaptively batched
+      int seams = max(1, width / 20);
+      record("carve-exact", measure([&]() {
+        copyImage(original, work);
+        carveVerticalSeams(work, width - seams, 1);
+      }), pixels * seams, seams);
+      //the same exact carve with one context kept across calls, so only the first call allocates
+      CarveContext* context = createCarveContext();
+      record("carve-context", measure([&]() {
+        copyImage(original, work);
+        carveVerticalSeams(work, width - seams, context);
+      }), pixels * seams, seams);
+      if (heapAllocations() >= 0) {
+        copyImage(original, work);
+        long long before = heapAllocations();
+        carveVerticalSeams(work, width - seams, context);
+        printf("%-11s %-9s %-27s %lld heap allocations for %d seams\n", size.c_str(), content.c_str(), "carve-context",
+               heapAllocations() - before, seams);
+      }
+      //the same seams removed lazily, compacted once at the end
+      record("carve-lazy", measure([&]() {
+        copyImage(original, work);
+        LazyImage* lazy = createLazyImage(work);
+        carveVerticalSeams(lazy, width - seams, context);
+        compactImage(lazy);
+        deleteLazyImage(lazy);
+      }), pixels * seams, seams);
+      //the DP's cost table refilled for every seam against kept and updated between seams;
+      //only the cone below each seam is recomputed, so the gap grows with the width
+      auto carveCost = [&](bool incremental) {
+        copyImage(original, work);
+        EnergyMap* map = createEnergyMap(work);
+        for (int k = 0; k < seams; ++k) {
+          traceMinVerticalSeam(map, seam.data(), SEAM_DP, context);
+          removeVerticalSeam(work, seam.data(), map);
+          if (incremental && k + 1 < seams) {
+            updateVerticalCost(map, seam.data(), context);
+          }
+        }
+        deleteEnergyMap(map);
+      };
+      double full = measure([&]() { carveCost(false); });
+      double incremental = measure([&]() { carveCost(true); });
+      record("carve-full-cost", full, pixels * seams, seams);
+      record("carve-incremental-cost", incremental, pixels * seams, seams);
+      printf("%-11s %-9s %-27s %.2fx the full-table carve\n", size.c_str(), content.c_str(), "carve-incremental-cost", full / incremental);
+      deleteCarveContext(context);
+      record("carve-batched", measure([&]() {
+        copyImage(original, work);
+        carveVerticalSeams(work, width - seams, 0);
+      }), pixels * seams, seams);
+
+      //the pyramid search, with the energy it removes compared to the exact carve
+      copyImage(original, work);
+      double exactEnergy = static_cast<double>(retargetImage(work, width - seams, height).energyRemoved);
+      copyImage(original, work);
+      double pyramidEnergy = static_cast<double>(retargetImage(work, width - seams, height, ORDER_GREEDY, SEAM_PYRAMID).energyRemoved);
+      record("carve-pyramid", measure([&]() {
+        copyImage(original, work);
+        carveVerticalSeams(work, width - seams, 1, SEAM_PYRAMID);
+      }), pixels * seams, seams, exactEnergy > 0 ? (pyramidEnergy - exactEnergy) / exactEnergy : 0.0);
+
+      //the exact carve again in each compact pixel format
+      record("carve-rgb8", measure([&]() { carveFormat<RGB8>(original, width - seams); }), pixels * seams, seams);
+      record("carve-rgba8", measure([&]() { carveFormat<RGBA8>(original, width - seams); }), pixels * seams, seams);
+      record("carve-gray8", measure([&]() { carveFormat<Gray8>(original, width - seams); }), pixels * seams, seams);
+      record("carve-rgb16", measure([&]() { carveFormat<RGB16>(original, width - seams); }), pixels * seams, seams);
+
+      //and with each energy policy
+      benchmarkPolicy<DualGradientEnergy>(record, original, work, seams, pixels);
+      benchmarkPolicy<SobelEnergy>(record, original, work, seams, pixels);
+      benchmarkPolicy<ForwardEnergy>(record, original, work, seams, pixels);
+      benchmarkPolicy<LuminanceEnergy>(record, original, work, seams, pixels);
+
+      //PPM I/O through a scratch file, loaded back into a full-size image
+      copyImage(original, work);
+      record("outputImage-P3", measure([&]() {
+        outputImage(scratchFile + ".ppm", original, PPM_ASCII);
+      }), pixels, 0);
+      record("loadImage-P3", measure([&]() {
+        loadImage(scratchFile + ".ppm", work);
+      }), pixels, 0);
+      record("outputImage-P6", measure([&]() {
+        outputImage(scratchFile + ".pnm", original, PPM_BINARY);
+      }), pixels, 0);
+      record("loadImage-P6", measure([&]() {
+        loadImage(scratchFile + ".pnm", work);
+      }), pixels, 0);
+      remove((scratchFile + ".ppm").c_str());
+      remove((scratchFile + ".pnm").c_str());
+
+      deleteEnergyMap(energies);
+      deleteImage(work);
+      deleteImage(original);
+    }
+  }
+
+  if (!jsonPath.empty()) {
+    writeJson(jsonPath, label, results);
+  }
+  return 0;
+}
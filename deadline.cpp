@@ -0,0 +1,223 @@
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "deadline.h"
+#include "internal.h"
+
+using namespace std;
+
+//seconds per seam per pixel of the image each strategy is assumed to take until it has been
+//measured, and what a resample is assumed to take per pixel, transposes included. Only the
+//resample's stays in use: it runs at most once per direction, and decides the time held back
+static const double PRIOR_SECONDS_PER_PIXEL[STRATEGY_COUNT] = { 3e-9, 1e-9, 1.5e-9, 2e-8 };
+
+const char* strategyName(CarveStrategy strategy) {
+  switch (strategy) {
+    case STRATEGY_EXACT: return "exact";
+    case STRATEGY_BATCHED: return "batched";
+    case STRATEGY_BANDED: return "banded";
+    case STRATEGY_RESAMPLED: return "resampled";
+    default: return "unknown";
+  }
+}
+
+//scale every row of image down to targetWidth pixels. Output pixel x covers input columns
+//[x * width / targetWidth, (x + 1) * width / targetWidth) and is their average, the partial
+//columns at either end weighted by how much of them it covers; all in integers, in units
+//of 1 / targetWidth of an input column
+static void resampleColumns(Image* image, int targetWidth) {
+  PROFILE_PHASE(PHASE_REMOVE);
+  int width = image->width;
+  parallelBlocks(image->height, rowsPerThread(width), [&](int first, int last) {
+    vector<Pixel> source(width);
+    for (int row = first; row < last; ++row) {
+      Pixel* line = imageRow(image, row);
+      copy(line, line + width, source.begin());
+      for (int x = 0; x < targetWidth; ++x) {
+        long long lo = static_cast<long long>(x) * width;
+        long long hi = lo + width;
+        long long r = 0, g = 0, b = 0;
+        for (long long i = lo / targetWidth; i * targetWidth < hi; ++i) {
+          long long weight = min(hi, (i + 1) * targetWidth) - max(lo, i * targetWidth);
+          r += weight * source[i].r;
+          g += weight * source[i].g;
+          b += weight * source[i].b;
+        }
+        line[x] = { static_cast<int>((r + width / 2) / width), static_cast<int>((g + width / 2) / width),
+                    static_cast<int>((b + width / 2) / width) };
+      }
+    }
+  });
+  image->width = targetWidth;
+}
+
+//the same averaging down the columns, scaling image to targetHeight rows without a transpose.
+//Output row y only reads input rows y and later, so rows are written over in place from the
+//top; threads take blocks of columns
+static void resampleRows(Image* image, int targetHeight) {
+  PROFILE_PHASE(PHASE_REMOVE);
+  int height = image->height;
+  parallelBlocks(image->width, rowsPerThread(height), [&](int first, int last) {
+    vector<long long> sums(3 * (last - first));
+    for (int y = 0; y < targetHeight; ++y) {
+      long long lo = static_cast<long long>(y) * height;
+      long long hi = lo + height;
+      fill(sums.begin(), sums.end(), 0);
+      for (long long i = lo / targetHeight; i * targetHeight < hi; ++i) {
+        long long weight = min(hi, (i + 1) * targetHeight) - max(lo, i * targetHeight);
+        const Pixel* line = imageRow(image, static_cast<int>(i));
+        for (int col = first; col < last; ++col) {
+          long long* sum = &sums[3 * (col - first)];
+          sum[0] += weight * line[col].r;
+          sum[1] += weight * line[col].g;
+          sum[2] += weight * line[col].b;
+        }
+      }
+      Pixel* out = imageRow(image, y);
+      for (int col = first; col < last; ++col) {
+        const long long* sum = &sums[3 * (col - first)];
+        out[col] = { static_cast<int>((sum[0] + height / 2) / height), static_cast<int>((sum[1] + height / 2) / height),
+                     static_cast<int>((sum[2] + height / 2) / height) };
+      }
+    }
+  });
+  image->height = targetHeight;
+}
+
+//how the carve is doing against its deadline, shared by both directions
+struct DeadlineProgress {
+  chrono::steady_clock::time_point deadline;
+  double secondsPerPixel[STRATEGY_COUNT];  // per seam, measured or PRIOR_SECONDS_PER_PIXEL
+  bool measured[STRATEGY_COUNT];
+  CarveStrategy strategy;
+};
+
+static double secondsLeft(const DeadlineProgress& progress) {
+  return chrono::duration<double>(progress.deadline - chrono::steady_clock::now()).count();
+}
+
+//remove vertical seams from image down to targetWidth. The other direction still has
+//laterPixels of work waiting, in seam-pixels, and would need laterArea pixels resampled at
+//worst, so this direction leaves time for both
+static void carveDirection(Image* image, int targetWidth, double laterPixels, double laterArea,
+                           DeadlineProgress& progress, CarveContext* context, DeadlineStats& stats) {
+  EnergyMap* energies = nullptr;
+  vector<int> seam(image->height);
+  bool previousExact = false;
+  //adaptiveSeamsPerPass's cap, held for the whole direction: its taper towards single seams
+  //near the target would make batches as slow as exact seams just when time is short
+  int batch = max(1, image->width / 32);
+
+  while (image->width > targetWidth) {
+    int remaining = image->width - targetWidth;
+    double pixels = static_cast<double>(image->width) * image->height;
+    //seam-pixels still to go, with the image narrowing as it goes, and a resample held back
+    double work = remaining * (image->width - (remaining - 1) / 2.0) * image->height + laterPixels;
+    double left = secondsLeft(progress) - PRIOR_SECONDS_PER_PIXEL[STRATEGY_RESAMPLED] * (pixels + laterArea);
+    //a strategy takes its next step if the rest could still be finished after it by the next
+    //one (or by itself, if that is no faster); the last seam strategy just needs its step to fit
+    while (progress.strategy != STRATEGY_RESAMPLED) {
+      double pace = progress.secondsPerPixel[progress.strategy];
+      double step = (progress.strategy == STRATEGY_BATCHED ? min(remaining, batch) : 1) * pixels;
+      double after = progress.strategy + 1 == STRATEGY_RESAMPLED ? 0.0 : min(pace, progress.secondsPerPixel[progress.strategy + 1]);
+      if (pace * step + after * max(0.0, work - step) <= left) {
+        break;
+      }
+      progress.strategy = static_cast<CarveStrategy>(progress.strategy + 1);
+    }
+    //the energy map is only made once a seam is actually going to be searched
+    if (progress.strategy != STRATEGY_RESAMPLED && energies == nullptr) {
+      energies = createEnergyMap(image);
+      if (energies == nullptr) {
+        progress.strategy = STRATEGY_RESAMPLED;
+      }
+    }
+
+    if (progress.strategy == STRATEGY_RESAMPLED) {
+      resampleColumns(image, targetWidth);
+      stats.removed[STRATEGY_RESAMPLED] += remaining;
+      break;
+    }
+
+    auto start = chrono::steady_clock::now();
+    int removed = 1;
+    if (progress.strategy == STRATEGY_EXACT) {
+      if (previousExact) {
+        updateVerticalCost(energies, seam.data(), context);
+      }
+      traceMinVerticalSeam(energies, seam.data(), SEAM_DP, context);
+      removeVerticalSeam(image, seam.data(), energies);
+    }
+    else if (progress.strategy == STRATEGY_BATCHED) {
+      removed = removeVerticalSeams(image, min(remaining, batch), energies);
+    }
+    else {
+      traceMinVerticalSeam(energies, seam.data(), SEAM_PYRAMID, context);
+      removeVerticalSeam(image, seam.data(), energies);
+    }
+    stats.removed[progress.strategy] += removed;
+    if (progress.strategy == STRATEGY_EXACT && !previousExact) {
+      //an exact step after anything else fills the whole cost table, later ones only update it
+      previousExact = true;
+      continue;
+    }
+    previousExact = progress.strategy == STRATEGY_EXACT;
+
+    //pace in seconds per seam-pixel, smoothed so one slow step doesn't force a switch
+    double sample = chrono::duration<double>(chrono::steady_clock::now() - start).count() / (removed * pixels);
+    double& pace = progress.secondsPerPixel[progress.strategy];
+    pace = progress.measured[progress.strategy] ? 0.5 * pace + 0.5 * sample : sample;
+    progress.measured[progress.strategy] = true;
+  }
+  deleteEnergyMap(energies);
+}
+
+DeadlineStats carveWithDeadline(Image* image, int targetWidth, int targetHeight, double budgetSeconds, CarveContext* context) {
+  auto start = chrono::steady_clock::now();
+  DeadlineStats stats = { 0.0, budgetSeconds, { 0, 0, 0, 0 }, STRATEGY_EXACT, 0.0 };
+  DeadlineProgress progress = { start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(max(0.0, budgetSeconds))),
+                                { 0, 0, 0, 0 }, { false, false, false, false }, STRATEGY_EXACT };
+  copy(PRIOR_SECONDS_PER_PIXEL, PRIOR_SECONDS_PER_PIXEL + STRATEGY_COUNT, progress.secondsPerPixel);
+  targetWidth = max(1, targetWidth);
+  targetHeight = max(1, targetHeight);
+
+  CarveContext* owned = context == nullptr ? createCarveContext() : nullptr;
+  if (context == nullptr) {
+    context = owned;
+  }
+
+  //horizontal seams, still to come, on an image targetWidth wide
+  double laterArea = image->height > targetHeight ? static_cast<double>(min(image->width, targetWidth)) * image->height : 0.0;
+  int rows = max(0, image->height - targetHeight);
+  double laterPixels = rows * (image->height - (rows - 1) / 2.0) * min(image->width, targetWidth);
+  carveDirection(image, targetWidth, laterPixels, laterArea, progress, context, stats);
+
+  //seams need the image transposed; without room for the copy the rows are resampled instead
+  Image* transposed = nullptr;
+  if (image->height > targetHeight && progress.strategy != STRATEGY_RESAMPLED) {
+    transposed = createImage(image->height, image->width);
+    if (transposed == nullptr) {
+      progress.strategy = STRATEGY_RESAMPLED;
+    }
+  }
+  if (transposed != nullptr) {
+    transposeImage(image, transposed);
+    carveDirection(transposed, targetHeight, 0.0, 0.0, progress, context, stats);
+    transposeImage(transposed, image);
+    deleteImage(transposed);
+  }
+  else if (image->height > targetHeight) {
+    stats.removed[STRATEGY_RESAMPLED] += image->height - targetHeight;
+    resampleRows(image, targetHeight);
+  }
+  deleteCarveContext(owned);
+
+  int total = 0;
+  for (int strategy = 0; strategy < STRATEGY_COUNT; ++strategy) {
+    total += stats.removed[strategy];
+  }
+  stats.strategy = progress.strategy;
+  stats.exactShare = total > 0 ? static_cast<double>(stats.removed[STRATEGY_EXACT]) / total : 1.0;
+  stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  return stats;
+}
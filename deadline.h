@@ -0,0 +1,41 @@
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+#include "functions.h"
+
+// carving against a time budget. Seams are removed exactly, one at a time, while the time each
+// strategy has taken per seam says the rest of the carve still fits in what is left of the
+// budget; when it wouldn't, the carve moves down to the next, cheaper strategy for good:
+//   exact      one DP seam at a time, as carveVerticalSeams
+//   batched    removeVerticalSeams, width / 32 seams per cost table
+//   banded     the pyramid search (see SEAM_PYRAMID), one seam at a time
+//   resampled  what is left of the width or height is scaled away in one area-averaging pass
+// Time for the final resample is always held back, so the carve overshoots the budget by
+// little more than one step of whichever strategy it is on, or by the resample itself when
+// the budget is shorter than that. Vertical seams come first, then
+// horizontal ones on a transpose, both under the same budget. An energy map or transpose
+// that can't be allocated sends the carve straight to resampling.
+enum CarveStrategy {
+  STRATEGY_EXACT,
+  STRATEGY_BATCHED,
+  STRATEGY_BANDED,
+  STRATEGY_RESAMPLED,
+  STRATEGY_COUNT
+};
+
+const char* strategyName(CarveStrategy strategy);
+
+struct DeadlineStats {
+  double seconds;                // wall time of the whole carve
+  double budget;
+  int removed[STRATEGY_COUNT];   // columns plus rows each strategy took out
+  CarveStrategy strategy;        // cheapest strategy the carve had to go down to
+  double exactShare;             // share of the removed columns and rows that were exact seams
+};
+
+// carve image down to targetWidth x targetHeight within about budgetSeconds; context is
+// optional and only lends its buffers
+DeadlineStats carveWithDeadline(Image* image, int targetWidth, int targetHeight, double budgetSeconds,
+                                CarveContext* context = nullptr);
+
+#endif
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <vector>
+#include "energypolicy.h"
+#include "internal.h"
+
+using namespace std;
+
+//rows next to y, wrapped around; the row itself when the image is shorter than 3
+static void neighbourRows(const Image* image, int y, const Pixel*& above, const Pixel*& below) {
+  int height = image->height;
+  above = imageRow(image, height >= 3 ? (y - 1 + height) % height : y);
+  below = imageRow(image, height >= 3 ? (y + 1) % height : y);
+}
+
+template <class Energy>
+int energy(const Image* image, int x, int y) {
+  int width = image->width;
+  const Pixel* above;
+  const Pixel* below;
+  neighbourRows(image, y, above, below);
+  int left = width >= 3 ? (x - 1 + width) % width : x;
+  int right = width >= 3 ? (x + 1) % width : x;
+  PROFILE_COUNT(COUNTER_ENERGY_EVALUATIONS, 1);
+  return Energy::pixel(above, imageRow(image, y), below, left, x, right);
+}
+
+//energies of columns [first, last) of row y
+template <class Energy>
+static void energySpan(const Image* image, int y, int first, int last, int* out) {
+  int width = image->width;
+  if (width < 3 || first == 0 || last == width) {
+    //a border column is in the span, leave the wrap-around to energy()
+    for (int col = first; col < last; ++col) {
+      out[col] = energy<Energy>(image, col, y);
+    }
+    return;
+  }
+  const Pixel* above;
+  const Pixel* below;
+  neighbourRows(image, y, above, below);
+  const Pixel* row = imageRow(image, y);
+  for (int col = first; col < last; ++col) {
+    out[col] = Energy::pixel(above, row, below, col - 1, col, col + 1);
+  }
+  PROFILE_COUNT(COUNTER_ENERGY_EVALUATIONS, last - first);
+}
+
+template <class Energy>
+void computeEnergyRow(const Image* image, int y, int* out) {
+  int width = image->width;
+  if (width < 3) {
+    energySpan<Energy>(image, y, 0, width, out);
+    return;
+  }
+  energySpan<Energy>(image, y, 1, width - 1, out);
+  out[0] = energy<Energy>(image, 0, y);
+  out[width - 1] = energy<Energy>(image, width - 1, y);
+}
+
+//the default policy goes through the SIMD rows of functions.cpp
+template <>
+void computeEnergyRow<DualGradientEnergy>(const Image* image, int y, int* out) {
+  computeEnergyRow(image, y, out);
+}
+
+template <class Energy>
+static void fillEnergyMap(const Image* image, EnergyMap* energies) {
+  PROFILE_PHASE(PHASE_ENERGY);
+  energies->width = image->width;
+  energies->height = image->height;
+  parallelBlocks(image->height, rowsPerThread(image->width), [&](int first, int last) {
+    for (int row = first; row < last; ++row) {
+      computeEnergyRow<Energy>(image, row, energyMapRow(energies, row));
+    }
+  });
+}
+
+template <class Energy>
+EnergyMap* createEnergyMap(const Image* image) {
+  EnergyMap* energies = allocateEnergyMap(image->width, image->height, image->stride);
+  if (energies != nullptr) {
+    fillEnergyMap<Energy>(image, energies);
+  }
+  return energies;
+}
+
+//a pixel's 3x3 block only changed if a seam in its row or the rows next to it passed within
+//one column of it, so each row refreshes from one left of the leftmost of those three seams
+//to one right of the rightmost, plus both border columns, whose blocks wrap around
+template <class Energy>
+static void updateEnergiesAfterVerticalSeam(const Image* image, EnergyMap* energies, const int* verticalSeam) {
+  PROFILE_PHASE(PHASE_ENERGY);
+  int width = image->width;
+  int height = image->height;
+  energies->width = width;
+
+  if (width < 3) {
+    for (int row = 0; row < height; ++row) {
+      energySpan<Energy>(image, row, 0, width, energyMapRow(energies, row));
+    }
+    return;
+  }
+
+  parallelBlocks(height, rowsPerThread(width), [&](int firstRow, int lastRow) {
+    for (int row = firstRow; row < lastRow; ++row) {
+      int lowest = verticalSeam[row];
+      int highest = verticalSeam[row];
+      if (height >= 3) {
+        int neighbours[2] = { (row - 1 + height) % height, (row + 1) % height };
+        for (int neighbour : neighbours) {
+          lowest = min(lowest, verticalSeam[neighbour]);
+          highest = max(highest, verticalSeam[neighbour]);
+        }
+      }
+      int* line = energyMapRow(energies, row);
+      int first = max(1, lowest - 1);
+      int last = min(width - 1, highest + 1);
+      if (first < last) {
+        energySpan<Energy>(image, row, first, last, line);
+      }
+      line[0] = energy<Energy>(image, 0, row);
+      line[width - 1] = energy<Energy>(image, width - 1, row);
+    }
+  });
+}
+
+template <class Energy>
+void removeVerticalSeam(Image* image, const int* verticalSeam, EnergyMap* energies) {
+  PROFILE_PHASE(PHASE_REMOVE);
+  PROFILE_COUNT(COUNTER_SEAMS_REMOVED, 1);
+  //slide everything right of the seam one pixel left
+  int width = image->width;
+  closeVerticalSeam(image, verticalSeam, image, energies);
+  image->width = width - 1;
+
+  if (energies != nullptr) {
+    updateEnergiesAfterVerticalSeam<Energy>(image, energies, verticalSeam);
+  }
+}
+
+template <class Energy>
+int carveVerticalSeams(Image* image, int targetWidth, CarveContext* context, SeamMode mode) {
+  if (image->width <= targetWidth) {
+    return 0;
+  }
+  EnergyMap* energies = createEnergyMap<Energy>(image);
+  if (energies == nullptr) {
+    return 0;
+  }
+  vector<int> seam(image->height);
+  int removed = 0;
+  while (image->width > targetWidth) {
+    traceMinVerticalSeam(energies, seam.data(), mode, context);
+    removeVerticalSeam<Energy>(image, seam.data(), energies);
+    if (image->width > targetWidth) {
+      updateVerticalCost(energies, seam.data(), context);
+    }
+    ++removed;
+  }
+  deleteEnergyMap(energies);
+  return removed;
+}
+
+//every policy is symmetric under a transpose except ForwardEnergy, which then measures the
+//edges a horizontal seam would create, as it should
+template <class Energy>
+int carveHorizontalSeams(Image* image, int targetHeight, CarveContext* context, SeamMode mode) {
+  if (image->height <= targetHeight) {
+    return 0;
+  }
+  Image* transposed = createImage(image->height, image->width);
+  if (transposed == nullptr) {
+    return 0;
+  }
+  transposeImage(image, transposed);
+  int removed = carveVerticalSeams<Energy>(transposed, targetHeight, context, mode);
+  transposeImage(transposed, image);
+  deleteImage(transposed);
+  return removed;
+}
+
+#define INSTANTIATE_ENERGY_POLICY(Energy)                                                   \
+  template int energy<Energy>(const Image*, int, int);                                      \
+  template void computeEnergyRow<Energy>(const Image*, int, int*);                          \
+  template EnergyMap* createEnergyMap<Energy>(const Image*);                                \
+  template void removeVerticalSeam<Energy>(Image*, const int*, EnergyMap*);                 \
+  template int carveVerticalSeams<Energy>(Image*, int, CarveContext*, SeamMode);            \
+  template int carveHorizontalSeams<Energy>(Image*, int, CarveContext*, SeamMode);
+
+INSTANTIATE_ENERGY_POLICY(DualGradientEnergy)
+INSTANTIATE_ENERGY_POLICY(SobelEnergy)
+INSTANTIATE_ENERGY_POLICY(ForwardEnergy)
+INSTANTIATE_ENERGY_POLICY(LuminanceEnergy)
@@ -0,0 +1,90 @@
+#ifndef ENERGYPOLICY_H
+#define ENERGYPOLICY_H
+
+#include "functions.h"
+
+// energy metrics as compile-time policies. The carving functions below take the policy as a
+// template argument, so its per-pixel function is inlined into the energy loops instead of
+// being called through a pointer. An energy policy is a type with
+//
+//   static int pixel(const Pixel* above, const Pixel* row, const Pixel* below, int left, int col, int right)
+//       energy of row[col]; above/below are the rows next to it and left/right the columns,
+//       wrapped around at the borders. Along a side shorter than 3 pixels they are the
+//       pixel's own row or column, which cancels the gradient in that direction
+//   static const char* name()
+//
+// it may only look at the 3x3 block around the pixel, which is what the incremental energy
+// update after a seam removal relies on
+
+// the dual-gradient energy of energy(): squared RGB differences left/right plus above/below.
+// The default; its energy rows go through computeEnergyRow and are bit-exact with the int API
+struct DualGradientEnergy {
+  static int pixel(const Pixel* above, const Pixel* row, const Pixel* below, int left, int col, int right) {
+    int rx = row[right].r - row[left].r, gx = row[right].g - row[left].g, bx = row[right].b - row[left].b;
+    int ry = below[col].r - above[col].r, gy = below[col].g - above[col].g, by = below[col].b - above[col].b;
+    return rx * rx + gx * gx + bx * bx + ry * ry + gy * gy + by * by;
+  }
+  static const char* name() { return "dual-gradient"; }
+};
+
+// 3x3 Sobel gradients per channel, squared and summed. Smoother than the dual gradient, so
+// seams avoid edges that are more than a pixel wide; about twice the arithmetic
+struct SobelEnergy {
+  static int pixel(const Pixel* above, const Pixel* row, const Pixel* below, int left, int col, int right) {
+    int total = 0;
+    for (int channel = 0; channel < 3; ++channel) {
+      auto sample = [channel](const Pixel& p) { return channel == 0 ? p.r : (channel == 1 ? p.g : p.b); };
+      int gx = sample(above[right]) + 2 * sample(row[right]) + sample(below[right])
+             - sample(above[left]) - 2 * sample(row[left]) - sample(below[left]);
+      int gy = sample(below[left]) + 2 * sample(below[col]) + sample(below[right])
+             - sample(above[left]) - 2 * sample(above[col]) - sample(above[right]);
+      total += gx * gx + gy * gy;
+    }
+    return total;
+  }
+  static const char* name() { return "sobel"; }
+};
+
+// forward energy: what removing the pixel would cost instead of what it holds. A vertical
+// seam through it makes its left and right neighbours adjacent, and joins one of them to the
+// pixel above; the energy is |left - right| plus the cheaper of the two joins (sums of absolute
+// RGB differences). Horizontal carving sees it on the transpose, i.e. for horizontal seams.
+// Tends to keep straight edges from breaking up where the backward energies see a flat area
+struct ForwardEnergy {
+  static int difference(const Pixel& a, const Pixel& b) {
+    return (a.r > b.r ? a.r - b.r : b.r - a.r) + (a.g > b.g ? a.g - b.g : b.g - a.g) + (a.b > b.b ? a.b - b.b : b.b - a.b);
+  }
+  static int pixel(const Pixel* above, const Pixel* row, const Pixel*, int left, int col, int right) {
+    int joinLeft = difference(above[col], row[left]);
+    int joinRight = difference(above[col], row[right]);
+    return difference(row[left], row[right]) + (joinLeft < joinRight ? joinLeft : joinRight);
+  }
+  static const char* name() { return "forward"; }
+};
+
+// the dual gradient of the luma, (77 r + 150 g + 29 b) / 256, instead of all three channels:
+// two squares a pixel instead of six, and blind to edges between colours of equal brightness
+struct LuminanceEnergy {
+  static int luma(const Pixel& p) { return (77 * p.r + 150 * p.g + 29 * p.b) >> 8; }
+  static int pixel(const Pixel* above, const Pixel* row, const Pixel* below, int left, int col, int right) {
+    int dx = luma(row[right]) - luma(row[left]);
+    int dy = luma(below[col]) - luma(above[col]);
+    return dx * dx + dy * dy;
+  }
+  static const char* name() { return "luminance"; }
+};
+
+// the functions below are instantiated for the four policies above in energypolicy.cpp and
+// behave like their namesakes in functions.h, e.g. createEnergyMap<SobelEnergy>(image)
+
+template <class Energy> int energy(const Image* image, int x, int y);
+template <class Energy> void computeEnergyRow(const Image* image, int y, int* out);
+template <class Energy> EnergyMap* createEnergyMap(const Image* image);
+// energies must have come from createEnergyMap<Energy>, or be nullptr to move the pixels only
+template <class Energy> void removeVerticalSeam(Image* image, const int* verticalSeam, EnergyMap* energies);
+
+// one seam at a time with the DP or the pyramid search (SEAM_GREEDY uses the DP)
+template <class Energy> int carveVerticalSeams(Image* image, int targetWidth, CarveContext* context, SeamMode mode = SEAM_DP);
+template <class Energy> int carveHorizontalSeams(Image* image, int targetHeight, CarveContext* context, SeamMode mode = SEAM_DP);
+
+#endif
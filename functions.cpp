@@ -1,517 +1,2216 @@
-
-// compile command:  g++ -std=c++17 -Wall -Wextra -pedantic -Weffc++ functions.cpp seamcarving.cpp
-
-/*
-IMPORTANT NOTES:
-- width = # of columns
-- height = # of rows
-- pixels begin at the upper left corner of the image and traverse down and to the right
-- index with [col][row] instead of [row][col]
-- Pixel struct holds integer values for red, green, and blue
-- we want to remove lower energy pixels
-- to calculate the energy of a pixel, we use the dual gradient energy function
-- dual gradient energy function: sqrt((deltax)^2(x, y) + (deltay)^2(x, y))
-- (deltax)^2 is calculated by finding the difference in the RGB values from the pixels 
-  right before and right after the pixel of choice and squaring them individually and then adding them
-- (deltay)^2 is found similarly but its the RGB values of the pixel right above and below
-  the pixel of choice, squaring each difference and adding them
-- to access values inside of Pixel struct, we have to use the built in function: <structurename>.<valuename>() ---> for this problem we use i.e image.red() 
-
-GAMEPLAN:
-- we need to go through every pixel, achieving this by starting at the top left and looping through a 2d array in a [col][row] fashion, at pixels not at the border,
-  we need to access the RGB values of that pixel through the Pixel struct. Using the RGB values and their difference to neighboring pixels, we can calculate the energy 
-  of a pixel and identify which of those are lower and higher, removing the lower energy pixels to reshape the image. The same is done for border pixels, however we have
-  to find the difference by using the other side of the image as the neighboring pixel if the end of the image is reached.
-*/
-
-#include <iostream>
-#include <string>
-#include <sstream>
-#include <fstream>
-#include <cmath>
-#include "functions.h"
-
-using namespace std;
-
-Pixel** createImage(int width, int height) {
-  cout << "Start createImage... " << endl;
-  
-  // Create a one dimensional array on the heap of pointers to Pixels 
-  //    that has width elements (i.e. the number of columns)
-  Pixel** image = new Pixel*[width];
-  
-  bool fail = false;
-  
-  for (int i=0; i < width; ++i) { // loop through each column
-    // assign that column to a one dimensional array on the heap of Pixels
-    //  that has height elements (i.e. the number of rows)
-    image[i] = new Pixel[height];
-    
-    if (image[i] == nullptr) { // failed to allocate
-      fail = true;
-    }
-  }
-  
-  if (fail) { // if any allocation fails, clean up and avoid memory leak
-    // deallocate any arrays created in for loop
-    for (int i=0; i < width; ++i) {
-      delete [] image[i]; // deleting nullptr is not a problem
-    }
-    delete [] image; // delete array of pointers
-    return nullptr;
-  }
-  
-  // initialize cells
-  //cout << "Initializing cells..." << endl;
-  for (int row=0; row<height; ++row) {
-    for (int col=0; col<width; ++col) {
-      //cout << "(" << col << ", " << row << ")" << endl;
-      image[col][row] = { 0, 0, 0 };
-    }
-  }
-  cout << "End createImage... " << endl;
-  return image;
-}
-
-void deleteImage(Pixel** image, int width) {
-  cout << "Start deleteImage..." << endl;
-  // avoid memory leak by deleting the array
-  for (int i=0; i<width; ++i) {
-    delete [] image[i]; // delete each individual array placed on the heap
-  }
-  delete [] image;
-  image = nullptr;
-}
-
-// implement for part 1
-
-int* createSeam(int length) {
-  //create a seam
-  int* seam = new int[length];
-
-  for (int i = 0; i < length; i++) {
-    seam[i] = 0;
-  }
-
-  return seam;
-}
-
-void deleteSeam(int* seam) {
-  //delete the seam
-  delete[] seam;
-}
-
-
-bool loadImage(string filename, Pixel** image, int width, int height) {
-
-/*
-- this function will open a file and load the pixels onto a 2d array
-- if loading was successful, return true, otherwise false
-- throw errors if:
-  1. too many color values (accounted for)
-  2. color values < 0 or > 255 (accounted for)
-  3. failed to open file (accounted for)
-  4. file type isnt P3 (accounted for)
-  5. contains non integer value (accounted for)
-  6. not enough color values (accounted for)
-  7. input value doesnt match value in file ()
-*/
-
-  //initialize essential variables
-  int i;
-  int j;
-  
-  ifstream fin;
-  int x = 0; //arbitrary constant to compare the type of the color with
-
-  //open the file
-  ifstream file(filename);
-  //file.open(filename, ios::in);
-  fin.open(filename);
-
-  //check if the file opens, if it doesnt, throw an error
-   if (!file.is_open()) {
-    cout << "Error: failed to open input file - " << filename << endl;
-    return false;
-  }
-  //check if the file is of type P3
-  char type[2];
-  fin >> type;
-  if((toupper(type[0]) != 'P') || (type[1] != '3')){
-    cout << "Error: type is " <<  type << " instead of P3" << endl;
-    return false;
-  }
-
-//test if the width and height match the values in the file
-  int w, h;
-  fin >> w;
-  if(w != width){
-    cout << "Error: input width (" << width << ") does not match value in file ("  << w << ")" << endl;
-    return false;
-  }
-  fin >> h;
-  if(h != height){
-    cout << "Error: input height (" << height << ") does not match value in file ("  << h << ")" << endl;
-    return false;
-  }
-
-  //check if the size is a valid number
-  int size;
-  fin >> size;
-  if (file.fail()) {
-    cout << "Error: read non-integer value" << endl;
-    return false;
-  }
-  if (size != 255) {
-    cout << "Error invalid color value" << endl;
-    return false;
-  }
-
-  //loop through all pixels
-  if(file.is_open()){
-    for(i=0;i<width;i++){
-      for(j=0;j<height;j++){
-
-        Pixel pixel_color;
-
-        //load pixels here
-        fin >> pixel_color.r >> pixel_color.g >> pixel_color.b;
-
-        //validate pixels
-        if(file.fail()){
-          cout << "Error: not enough color values" << endl;
-          return false;
-        }
-
-        //check if all the colors are of type <int>
-        if(typeid(pixel_color.r).name() != typeid(x).name()){
-          cout << "Error: read non-integer value" << endl;
-          return false;
-        }
-        else if(typeid(pixel_color.g).name() != typeid(x).name()){
-          cout << "Error: read non-integer value" << endl;
-          return false;
-        }
-        else if(typeid(pixel_color.b).name() != typeid(x).name()){
-          cout << "Error: read non-integer value" << endl;
-          return false;
-        }
-
-        //check if all colors are within 0-255 range
-        if(pixel_color.r > 255 || pixel_color.r < 0){
-          cout << "Error: invalid color value " << pixel_color.r << endl;
-          return false;
-        }
-        else if(pixel_color.g > 255 || pixel_color.g < 0){
-          cout << "Error: invalid color value " << pixel_color.g << endl;
-          return false;
-        }
-        else if(pixel_color.b > 255 || pixel_color.b < 0){
-          cout << "Error: invalid color value " << pixel_color.b << endl;
-          return false;
-        }
-
-        image[i][j].r = pixel_color.r;
-        image[i][j].g = pixel_color.g;
-        image[i][j].b = pixel_color.b;
-
-      if(file.eof()){
-        cout << "Error: not enough color values" << endl;
-      return false;  
-    }
-    }
-    //if the end of the file is hit before the entire loop is finished, this means that there are not enough colors
-    if(file.eof()){
-      cout << "Error: not enough color values" << endl;
-      return false;  
-    }
-    }
-
-    
-  }
-
-  //throw error if the file still doesnt end after the loop terminates
-  if(!file.eof()){
-    string temp = "yosif";
-    fin >> temp;
-    if(temp != "yosif"){
-      cout << "Error: too many color values" << endl; 
-      //cout << "Error: too many color values" << endl;
-      return false;
-    }
-  }
-
-  //throw error if file opening failed
-  else{
-    cout << "Error: failed to open input file - " << filename << endl;
-    return false;
-  }
-
-  //check for whitespaces
-  if (!(file >> std::ws).eof() ) {
-    cout <<"Error: not enough color values" << endl;
-    //cout << "Error: too many color values" << endl;
-    return false;
-  }
-
-  return true;
-}
-
-bool outputImage(string filename, const Pixel*const* image, int width, int height) {
-
-  //declare variables
-  ofstream file;
-  int i, j;
-
-  //open the file in write mode
-  file.open(filename);
-
-  //loop through all pixels and write them to a file
-  if(file.is_open()){
-    for(i=0; i<width; i++){
-      for(j=0; j<height; j++){
-        file << image[i][j].r  << " " << image[i][j].g  << " " << image[i][j].b << " ";
-    }
-  }
-  }
-  else{
-    cout << "Error: failed to open output file - " << filename << endl;
-    return false;
-  }
-  
-  return true;
-}
-
-int energy(const Pixel*const* image, int x, int y, int width, int height) { 
-  //this function calculates the energy of a pixel
-  //remember: dual gradient energy function = sqrt((deltax^2(x,y)) + (deltay^2(x,y)))
-  //image[col][row] == image[width][height] == image[x][y]  ****width is going left to right, height is going top to bottom****
-
-  //declare variables
-  int energy, energyRedx, energyRedy, energyGreenx, energyGreeny, energyBluex, energyBluey;
-  
-  //hidden test case for 2x2 array
-  if (width < 3) {
-    //energy will be zero
-    energyRedx = 0;
-    energyGreenx = 0;
-    energyBluex = 0;
-  } 
-  //for left side
-  else if (x == 0) {
-    energyRedx = pow((image[width - 1][y].r - image[x+1][y].r), 2);
-    energyGreenx = pow((image[width - 1][y].g - image[x+1][y].g), 2);
-    energyBluex = pow((image[width - 1][y].b - image[x+1][y].b), 2);
-  } 
-  //for right side
-  else if (x == width - 1) {
-    energyRedx = pow((image[x-1][y].r - image[0][y].r), 2);
-    energyGreenx = pow((image[x-1][y].g - image[0][y].g), 2);
-    energyBluex = pow((image[x-1][y].b - image[0][y].b), 2);
-  } 
-  //for all non edge cases
-  else {
-    energyRedx = pow((image[x+1][y].r - image[x-1][y].r), 2);
-    energyGreenx = pow((image[x+1][y].g - image[x-1][y].g), 2);
-    energyBluex = pow((image[x+1][y].b - image[x-1][y].b), 2);
-  }
-
-  if (height < 3) {
-    //energy will be zero
-    energyRedy = 0;
-    energyGreeny = 0;
-    energyBluey = 0;
-  } 
-  //for bottom side
-  else if (y == 0) {
-    energyRedy = pow((image[x][height - 1].r - image[x][y+1].r), 2);
-    energyGreeny = pow((image[x][height - 1].g - image[x][y+1].g), 2);
-    energyBluey = pow((image[x][height - 1].b - image[x][y+1].b), 2);
-  } 
-  //for top side
-  else if (y == height - 1) {
-    energyRedy = pow((image[x][0].r - image[x][y-1].r), 2);
-    energyGreeny = pow((image[x][0].g - image[x][y-1].g), 2);
-    energyBluey = pow((image[x][0].b - image[x][y-1].b), 2);
-  } 
-  //for all non edge cases
-  else {
-    energyRedy = pow((image[x][y+1].r - image[x][y-1].r), 2);
-    energyGreeny = pow((image[x][y+1].g - image[x][y-1].g), 2);
-    energyBluey = pow((image[x][y+1].b - image[x][y-1].b), 2); 
-  }
-
-  
-  energy = energyRedx + energyRedy + energyGreenx + energyGreeny + energyBluex + energyBluey;
-
-  return energy;
-}
-
-// implement for part 2
-
-// uncomment for part 2
- 
-//complete this function first
-int loadVerticalSeam(const Pixel*const* image, int start_col, int width, int height, int* seam) {
-
-  //image[col][row]
-  //seam if a dynamic array
-
-  //declare variables
-  int i;
-  int totalEnergy = energy(image, start_col, 0, width, height);
-  seam[0] = start_col;
-
-  /*
-  - traverse through image starting at first row of start_col
-  - traverse down the column by choosing the path of lowest energy
-  
-  PSEUDOCODE:
-  1. set seam for the first row to the starting column
-  */
-
-  for(i=1;i<height;i++){
-    //check if the width == 1
-    if(width == 1){
-      totalEnergy += energy(image, start_col, i, width, height);
-      seam[i] = start_col;
-    }
-    //for left side column
-    if(start_col == 0){
-      //check same column
-      if(energy(image, start_col, i, width, height) < energy(image, start_col+1, i, width, height)){
-        totalEnergy += energy(image, start_col, i, width, height);
-        seam[i] = start_col;
-      }
-      //check column just right of start col
-      else if(energy(image, start_col+1, i, width, height) < energy(image, start_col, i, width, height)){
-        totalEnergy += energy(image, start_col+1, i, width, height);
-        start_col += 1;
-        seam[i] = start_col;
-      }
-      //check if both sides are tied
-      else if(energy(image, start_col, i, width, height) == energy(image, start_col+1, i, width, height)){
-        totalEnergy += energy(image, start_col, i , width, height);
-        seam[i] = start_col;
-      }
-    }
-    //for right side column
-    else if(start_col == width-1){
-      //check same column
-      if(energy(image, start_col, i, width, height) < energy(image, start_col-1, i, width, height)){
-        totalEnergy += energy(image, start_col, i, width, height);
-        seam[i] = start_col;
-      }
-      //check column just left of start col
-      else if(energy(image, start_col-1, i, width, height) < energy(image, start_col, i, width, height)){
-        totalEnergy += energy(image, start_col-1 ,i, width, height);
-        start_col -= 1;
-        seam[i] = start_col;
-      }
-      else if(energy(image, start_col, i , width, height) == energy(image, start_col-1, i, width, height)){
-        totalEnergy += energy(image, start_col, i , width, height);
-        seam[i] = start_col;
-      }
-    }
-    //for middle columns
-    else{
-      //check if middle pixel has the lowest energy
-      if(energy(image, start_col, i, width, height) < energy(image, start_col+1, i, width, height) && energy(image, start_col, i, width, height) < energy(image, start_col-1, i, width, height)){
-        totalEnergy += energy(image, start_col, i, width, height);
-        seam[i] = start_col;
-        //start_col doesnt change
-      }
-      //check if right pixel has the lowest energy
-      else if(energy(image, start_col+1, i, width, height) < energy(image, start_col, i, width, height) && energy(image, start_col+1, i, width, height) < energy(image, start_col-1, i, width, height)){
-        totalEnergy += energy(image, start_col+1, i, width, height);
-        start_col += 1;
-        seam[i] = start_col;
-      }
-      //check if the left pixel has the lowest energy
-      else if(energy(image, start_col-1, i, width, height) < energy(image, start_col, i, width, height) && energy(image, start_col-1, i, width, height) < energy(image, start_col+1, i, width, height)){
-          totalEnergy += energy(image, start_col-1, i, width, height);
-          start_col -= 1;
-          seam[i] = start_col;
-      }
-      //check if start col ties with right col
-      else if(energy(image, start_col, i, width, height) < energy(image, start_col-1, i, width, height) && energy(image, start_col, i, width, height) == energy(image, start_col+1, i, width, height)){
-        totalEnergy += energy(image, start_col, i, width, height);
-        seam[i] = start_col;
-      }
-      //check if start_col ties with left col
-      else if(energy(image, start_col, i, width, height) < energy(image, start_col+1, i, width, height) && energy(image, start_col, i, width, height) == energy(image, start_col-1, i, width, height)){
-        totalEnergy += energy(image, start_col, i, width, height);
-        seam[i] = start_col;
-      }
-      //check if all three cols tie, it goes middle
-      else if(energy(image, start_col, i, width, height) == energy(image, start_col-1, i, width, height)  && energy(image, start_col-1, i, width, height) == energy(image, start_col+1, i, width, height)){
-        totalEnergy += energy(image, start_col, i, width, height);
-        seam[i] = start_col;
-      }
-      //check if left col ties with right col
-      else if(energy(image, start_col-1, i, width, height) < energy(image, start_col, i, width, height) && energy(image, start_col-1, i, width, height) == energy(image, start_col+1, i , width, height)){
-        totalEnergy += energy(image, start_col+1, i, width, height);
-        start_col += 1;
-        seam[i] = start_col;
-      }
-    }
-  }
-
-  return totalEnergy;
-}
-
-/*//optional
-int loadHorizontalSeam(const Pixel*const* image, int start_row, int width, int height, int* seam) {
-  return 0;
-}*/
-
-//complete this function second
-int* findMinVerticalSeam(const Pixel*const* image, int width, int height) {
-
-  int i;
-  int min = INT32_MAX;
-  int* seam = new int[height];
-  int* temp = new int[height];
-
-  for(i=0;i<width;i++){
-    if(loadVerticalSeam(image, i, width, height, seam) < min){
-      min = loadVerticalSeam(image, i, width, height, seam);
-      temp = seam;
-    }
-  } 
-
-  //deallocate seam
-  delete[] seam;
-
-  return temp;
-}
-
-/*//optional
-int* findMinHorizontalSeam(const Pixel*const* image, int width, int height) {
-  return nullptr;
-}*/
-
-//complete this function third
-void removeVerticalSeam(Pixel** image, int width, int height, int* verticalSeam) {
-  //declare variables
-  int i, j;
-  
-  //loop through rows
-  for(i=0;i<height;i++){
-  
-      for(j=verticalSeam[i];j<width-1;j++){
-      image[j][i].r = image[j+1][i].r;
-      image[j][i].g = image[j+1][i].g;
-      image[j][i].b = image[j+1][i].b;
-    
-    }
-    
-
-  }
-  
-}
-
-/*//optional
-void removeHorizontalSeam(Pixel** image, int width, int height, int* horizontalSeam) {
-}*/
-
+
+// compile command:  g++ -std=c++17 -Wall -Wextra -pedantic -Weffc++ -pthread functions.cpp instrument.cpp pixelformat.cpp energypolicy.cpp lazyimage.cpp batch.cpp removalindex.cpp streamcarve.cpp sequence.cpp deadline.cpp resultcache.cpp seamcarving.cpp
+// benchmark:        g++ -std=c++17 -O2 -pthread functions.cpp instrument.cpp pixelformat.cpp energypolicy.cpp lazyimage.cpp benchmark.cpp -o benchmark
+// library:          static and shared builds of the C API are in seamcarve.h
+// add -DSEAM_PROFILE to either for per-phase timers and counters (see instrument.h)
+// add -DSEAM_COUNT_ALLOCATIONS to either to count heap allocations (the benchmark then reports them)
+
+/*
+IMPORTANT NOTES:
+- width = # of columns
+- height = # of rows
+- pixels begin at the upper left corner of the image and traverse down and to the right
+- images are stored row-major in one buffer, pixel (col, row) is imageRow(image, row)[col]
+- Pixel struct holds integer values for red, green, and blue
+- we want to remove lower energy pixels
+- to calculate the energy of a pixel, we use the dual gradient energy function
+- dual gradient energy function: sqrt((deltax)^2(x, y) + (deltay)^2(x, y))
+- (deltax)^2 is calculated by finding the difference in the RGB values from the pixels 
+  right before and right after the pixel of choice and squaring them individually and then adding them
+- (deltay)^2 is found similarly but its the RGB values of the pixel right above and below
+  the pixel of choice, squaring each difference and adding them
+- to access values inside of Pixel struct, we have to use the built in function: <structurename>.<valuename>() ---> for this problem we use i.e image.red() 
+
+GAMEPLAN:
+- we need to go through every pixel, achieving this by starting at the top left and looping through a 2d array in a [col][row] fashion, at pixels not at the border,
+  we need to access the RGB values of that pixel through the Pixel struct. Using the RGB values and their difference to neighboring pixels, we can calculate the energy 
+  of a pixel and identify which of those are lower and higher, removing the lower energy pixels to reshape the image. The same is done for border pixels, however we have
+  to find the difference by using the other side of the image as the neighboring pixel if the end of the image is reached.
+*/
+
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SEAM_X86_SIMD 1
+#include <immintrin.h>
+#endif
+#include "functions.h"
+#include "internal.h"
+#include "instrument.h"
+
+using namespace std;
+
+//persistent worker threads, so a parallel section costs a wakeup instead of thread creation
+class WorkerPool {
+ public:
+  explicit WorkerPool(int workers) : threads(), lock(), wake(), done(), job(nullptr), jobCount(0), next(0), pending(0), generation(0), stopping(false) {
+    for (int i = 0; i < workers; ++i) {
+      threads.emplace_back([this]() { workerLoop(); });
+    }
+  }
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  ~WorkerPool() {
+    {
+      lock_guard<mutex> guard(lock);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (thread& worker : threads) {
+      worker.join();
+    }
+  }
+
+  //call work(i) for every i in [0, jobs) and return once all of them are done
+  //the calling thread runs jobs too
+  void run(int jobs, Callback<void(int)> work) {
+    if (threads.empty() || jobs <= 1) {
+      for (int i = 0; i < jobs; ++i) {
+        work(i);
+      }
+      return;
+    }
+    {
+      lock_guard<mutex> guard(lock);
+      job = &work;
+      jobCount = jobs;
+      next = 0;
+      pending = jobs;
+      ++generation;
+    }
+    wake.notify_all();
+    runJobs();
+    unique_lock<mutex> guard(lock);
+    done.wait(guard, [this]() { return pending == 0; });
+    job = nullptr;
+  }
+
+ private:
+  //jobs are claimed under the lock, there are only ever a handful per run
+  void runJobs() {
+    unique_lock<mutex> guard(lock);
+    while (next < jobCount) {
+      int i = next++;
+      const Callback<void(int)>* work = job;
+      guard.unlock();
+      (*work)(i);
+      guard.lock();
+      if (--pending == 0) {
+        done.notify_all();
+      }
+    }
+  }
+
+  void workerLoop() {
+    unsigned long seen = 0;
+    unique_lock<mutex> guard(lock);
+    while (true) {
+      wake.wait(guard, [&]() { return stopping || generation != seen; });
+      if (stopping) {
+        return;
+      }
+      seen = generation;
+      guard.unlock();
+      runJobs();
+      guard.lock();
+    }
+  }
+
+  vector<thread> threads;
+  mutex lock;
+  condition_variable wake;
+  condition_variable done;
+  const Callback<void(int)>* job;
+  int jobCount;
+  int next;
+  int pending;
+  unsigned long generation;
+  bool stopping;
+};
+
+static int hardwareThreads() {
+  int threads = static_cast<int>(thread::hardware_concurrency());
+  return threads > 0 ? threads : 1;
+}
+
+static int configuredThreads = hardwareThreads();
+static thread_local int threadsOnThisThread = 0; // setThreadCountOnThisThread, 0 = configuredThreads
+static unique_ptr<WorkerPool> workerPool;
+static mutex workerPoolLock;
+
+void setThreadCount(int threads) {
+  lock_guard<mutex> guard(workerPoolLock);
+  configuredThreads = threads > 0 ? threads : hardwareThreads();
+  workerPool.reset();
+}
+
+void setThreadCountOnThisThread(int threads) {
+  threadsOnThisThread = max(0, threads);
+}
+
+int threadCount() {
+  return threadsOnThisThread > 0 ? threadsOnThisThread : configuredThreads;
+}
+
+//run work(i) for every i in [0, jobs) on the worker pool
+//callers on different threads (batch mode) take turns with the pool
+static void parallelJobs(int jobs, Callback<void(int)> work) {
+  if (jobs <= 1 || threadCount() <= 1) {
+    for (int i = 0; i < jobs; ++i) {
+      work(i);
+    }
+    return;
+  }
+  lock_guard<mutex> guard(workerPoolLock);
+  if (workerPool == nullptr) {
+    workerPool.reset(new WorkerPool(configuredThreads - 1));
+  }
+  workerPool->run(jobs, work);
+}
+
+//split [0, count) into one contiguous block per thread and run work(first, last) on each
+//blocks never get smaller than minimum, so small inputs stay on the calling thread
+void parallelBlocks(int count, int minimum, Callback<void(int, int)> work) {
+  int blocks = min(threadCount(), count / max(minimum, 1));
+  if (blocks <= 1) {
+    work(0, count);
+    return;
+  }
+  parallelJobs(blocks, [&](int block) {
+    work(static_cast<int>(static_cast<long>(count) * block / blocks),
+         static_cast<int>(static_cast<long>(count) * (block + 1) / blocks));
+  });
+}
+
+//rows per block so that each thread gets at least this many pixels
+static const int PIXELS_PER_THREAD = 1 << 16;
+//columns per thread in the cumulative-cost table, narrower blocks are all halo
+static const int COLUMNS_PER_THREAD = 256;
+
+int rowsPerThread(int width) {
+  return max(1, PIXELS_PER_THREAD / max(width, 1));
+}
+
+static bool verbose = true;
+
+void setVerbose(bool enabled) {
+  verbose = enabled;
+}
+
+Image* createImage(int width, int height) {
+  if (verbose) {
+    cout << "Start createImage... " << endl;
+  }
+
+  if (width <= 0 || height <= 0) {
+    return nullptr;
+  }
+
+  // round each row up to a multiple of 16 Pixels (16 * 12 bytes = 3 cache lines)
+  //    so that every row starts on a 64 byte boundary
+  int stride = (width + 15) / 16 * 16;
+  size_t bytes = sizeof(Pixel) * static_cast<size_t>(stride) * static_cast<size_t>(height);
+
+  // one allocation for the whole image instead of one per column
+  Pixel* pixels = static_cast<Pixel*>(::operator new(bytes, std::align_val_t(64), std::nothrow));
+  if (pixels == nullptr) { // failed to allocate
+    return nullptr;
+  }
+
+  Image* image = new (std::nothrow) Image{ width, height, stride, pixels };
+  if (image == nullptr) { // clean up and avoid memory leak
+    ::operator delete(pixels, std::align_val_t(64));
+    return nullptr;
+  }
+  PROFILE_ALLOCATE(pixels, static_cast<long long>(bytes));
+
+  // initialize cells (padding included so the whole buffer is defined)
+  for (int row=0; row<height; ++row) {
+    Pixel* line = imageRow(image, row);
+    for (int col=0; col<stride; ++col) {
+      line[col] = { 0, 0, 0 };
+    }
+  }
+  if (verbose) {
+    cout << "End createImage... " << endl;
+  }
+  return image;
+}
+
+void deleteImage(Image* image) {
+  if (verbose) {
+    cout << "Start deleteImage..." << endl;
+  }
+  if (image == nullptr) {
+    return;
+  }
+  // avoid memory leak by deleting the pixel buffer and then the image itself
+  PROFILE_RELEASE(image->pixels);
+  ::operator delete(image->pixels, std::align_val_t(64));
+  delete image;
+}
+
+// implement for part 1
+
+int* createSeam(int length) {
+  //create a seam
+  int* seam = new int[length];
+
+  for (int i = 0; i < length; i++) {
+    seam[i] = 0;
+  }
+
+  return seam;
+}
+
+void deleteSeam(int* seam) {
+  //delete the seam
+  delete[] seam;
+}
+
+
+//read-only view of a whole file, memory-mapped so parsing never copies it
+class MappedFile {
+ public:
+  explicit MappedFile(const string& filename) : data(nullptr), size(0), opened(false) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0) {
+      opened = true;
+      size = static_cast<size_t>(info.st_size);
+      if (size > 0) {
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+          opened = false;
+          size = 0;
+        }
+        else {
+          data = static_cast<const char*>(mapped);
+          madvise(mapped, size, MADV_SEQUENTIAL);
+        }
+      }
+    }
+    close(fd);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    if (data != nullptr) {
+      munmap(const_cast<char*>(data), size);
+    }
+  }
+
+  const char* data;
+  size_t size;
+  bool opened;
+};
+
+//hand-rolled tokenizer for the text parts of a PPM file
+struct PpmScanner {
+  const char* cursor;
+  const char* end;
+};
+
+//outcomes of readPpmInt
+enum PpmToken {
+  PPM_INT,     // read an integer
+  PPM_END,     // nothing left but whitespace and comments
+  PPM_NOT_INT  // next token isn't an integer
+};
+
+static inline bool isPpmSpace(char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r'); // space, \t \n \v \f \r
+}
+
+//skip whitespace and # comments (which run to the end of the line)
+static inline void skipPpmSpace(PpmScanner& scanner) {
+  while (scanner.cursor < scanner.end) {
+    char c = *scanner.cursor;
+    if (isPpmSpace(c)) {
+      ++scanner.cursor;
+    }
+    else if (c == '#') {
+      while (scanner.cursor < scanner.end && *scanner.cursor != '\n') {
+        ++scanner.cursor;
+      }
+    }
+    else {
+      return;
+    }
+  }
+}
+
+static inline PpmToken readPpmInt(PpmScanner& scanner, int& value) {
+  skipPpmSpace(scanner);
+  if (scanner.cursor == scanner.end) {
+    return PPM_END;
+  }
+  const char* p = scanner.cursor;
+  bool negative = false;
+  if (*p == '-' || *p == '+') {
+    negative = (*p == '-');
+    ++p;
+  }
+  if (p == scanner.end || static_cast<unsigned>(*p - '0') > 9) {
+    return PPM_NOT_INT;
+  }
+  //stop accumulating runaway digit strings instead of overflowing, they fail range checks anyway
+  long long number = 0;
+  int digits = 0;
+  unsigned digit;
+  while (p < scanner.end && (digit = static_cast<unsigned>(*p - '0')) <= 9) {
+    if (++digits <= 12) {
+      number = number * 10 + digit;
+    }
+    ++p;
+  }
+  //the token has to end here, "12a" or "1.5" are not integers
+  if (p < scanner.end && !isPpmSpace(*p) && *p != '#') {
+    return PPM_NOT_INT;
+  }
+  scanner.cursor = p;
+  number = negative ? -number : number;
+  value = static_cast<int>(max(min(number, static_cast<long long>(INT32_MAX)), static_cast<long long>(INT32_MIN)));
+  return PPM_INT;
+}
+
+//common case of one separator, 1-3 digits and whitespace, at least 8 bytes from the
+//end of the file so nothing needs a bounds check
+//returns false without moving the scanner for anything else
+static inline bool readPpmSampleFast(PpmScanner& scanner, int& value) {
+  const char* p = scanner.cursor;
+  if (scanner.end - p < 8) {
+    return false;
+  }
+  if (isPpmSpace(*p)) {
+    ++p;
+  }
+  unsigned d0 = static_cast<unsigned>(p[0] - '0');
+  unsigned d1 = static_cast<unsigned>(p[1] - '0');
+  unsigned d2 = static_cast<unsigned>(p[2] - '0');
+  if (d0 > 9) {
+    return false;
+  }
+  if (d1 > 9) {
+    if (!isPpmSpace(p[1])) {
+      return false;
+    }
+    value = d0;
+    scanner.cursor = p + 1;
+    return true;
+  }
+  if (d2 > 9) {
+    if (!isPpmSpace(p[2])) {
+      return false;
+    }
+    value = d0 * 10 + d1;
+    scanner.cursor = p + 2;
+    return true;
+  }
+  if (!isPpmSpace(p[3])) {
+    return false;
+  }
+  value = d0 * 100 + d1 * 10 + d2;
+  scanner.cursor = p + 3;
+  return true;
+}
+
+//P3 body: width * height * 3 ASCII integers in 0-255, row by row
+//samples are rescaled to 0-range when range isn't 255
+static bool loadAsciiPixels(PpmScanner& scanner, Image* image, int range) {
+  for (int row = 0; row < image->height; ++row) {
+    Pixel* line = imageRow(image, row);
+    for (int col = 0; col < image->width; ++col) {
+      int color[3];
+      for (int channel = 0; channel < 3; ++channel) {
+        //the fast path has consumed its token either way, so its value is checked right here
+        if (!readPpmSampleFast(scanner, color[channel])) {
+          PpmToken token = readPpmInt(scanner, color[channel]);
+          if (token == PPM_END) {
+            cout << "Error: not enough color values" << endl;
+            return false;
+          }
+          if (token == PPM_NOT_INT) {
+            cout << "Error: read non-integer value" << endl;
+            return false;
+          }
+        }
+        if (color[channel] > 255 || color[channel] < 0) {
+          cout << "Error: invalid color value " << color[channel] << endl;
+          return false;
+        }
+      }
+      line[col] = { color[0], color[1], color[2] };
+    }
+  }
+  if (range != 255) {
+    for (int row = 0; row < image->height; ++row) {
+      Pixel* line = imageRow(image, row);
+      for (int col = 0; col < image->width; ++col) {
+        line[col] = { (line[col].r * range + 127) / 255, (line[col].g * range + 127) / 255, (line[col].b * range + 127) / 255 };
+      }
+    }
+  }
+
+  int extra;
+  if (readPpmInt(scanner, extra) != PPM_END) {
+    cout << "Error: too many color values" << endl;
+    return false;
+  }
+  return true;
+}
+
+//P6 body: raw samples, one byte each when maxval < 256, otherwise two bytes big-endian
+//samples are rescaled to 0-range when maxval isn't range
+static bool loadBinaryPixels(const char* data, size_t size, Image* image, int maxval, int range) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+  size_t sampleBytes = maxval < 256 ? 1 : 2;
+  size_t rowBytes = sampleBytes * 3 * image->width;
+  size_t needed = rowBytes * image->height;
+  if (size < needed) {
+    cout << "Error: not enough color values" << endl;
+    return false;
+  }
+  //a trailing newline is common, anything else is extra data
+  for (size_t i = needed; i < size; ++i) {
+    if (!isPpmSpace(data[i])) {
+      cout << "Error: too many color values" << endl;
+      return false;
+    }
+  }
+
+  //raw samples above maxval are invalid. Checked before anything is rescaled, since after it
+  //they can land inside the range; a separate pass keeps the decode loops branch free, and
+  //maxval 255 or 65535 leaves nothing to check
+  if (maxval != 255 && maxval != 65535) {
+    for (size_t i = 0; i < needed; i += sampleBytes) {
+      int sample = sampleBytes == 1 ? bytes[i] : (bytes[i] << 8) | bytes[i + 1];
+      if (sample > maxval) {
+        cout << "Error: invalid color value " << sample << endl;
+        return false;
+      }
+    }
+  }
+
+  //lookup table for the one byte case keeps the rescale out of the loop
+  int scale[256];
+  for (int value = 0; value < 256; ++value) {
+    scale[value] = (value * range + maxval / 2) / maxval;
+  }
+
+  parallelBlocks(image->height, rowsPerThread(image->width), [&](int first, int last) {
+    for (int row = first; row < last; ++row) {
+      const unsigned char* in = bytes + rowBytes * row;
+      Pixel* line = imageRow(image, row);
+      if (sampleBytes == 1 && maxval == range) {
+        for (int col = 0; col < image->width; ++col, in += 3) {
+          line[col] = { in[0], in[1], in[2] };
+        }
+      }
+      else if (sampleBytes == 1) {
+        for (int col = 0; col < image->width; ++col, in += 3) {
+          line[col] = { scale[in[0]], scale[in[1]], scale[in[2]] };
+        }
+      }
+      else if (maxval == range) {
+        for (int col = 0; col < image->width; ++col, in += 6) {
+          line[col] = { (in[0] << 8) | in[1], (in[2] << 8) | in[3], (in[4] << 8) | in[5] };
+        }
+      }
+      else {
+        //65535 * 65535 overflows an int once range goes above 255
+        long long half = maxval / 2;
+        for (int col = 0; col < image->width; ++col, in += 6) {
+          long long r = (in[0] << 8) | in[1];
+          long long g = (in[2] << 8) | in[3];
+          long long b = (in[4] << 8) | in[5];
+          line[col] = { static_cast<int>((r * range + half) / maxval), static_cast<int>((g * range + half) / maxval),
+                        static_cast<int>((b * range + half) / maxval) };
+        }
+      }
+    }
+  });
+
+  return true;
+}
+
+//magic number, width and height at the start of a P3/P6 file
+static bool readPpmSize(PpmScanner& scanner, bool& binary, int& width, int& height) {
+  //check if the file is of type P3 or P6
+  skipPpmSpace(scanner);
+  const char* magic = scanner.cursor;
+  while (scanner.cursor < scanner.end && !isPpmSpace(*scanner.cursor)) {
+    ++scanner.cursor;
+  }
+  string type(magic, scanner.cursor);
+  if((type.size() != 2) || (toupper(type[0]) != 'P') || (type[1] != '3' && type[1] != '6')){
+    cout << "Error: type is " <<  type << " instead of P3 or P6" << endl;
+    return false;
+  }
+  binary = (type[1] == '6');
+
+  if (readPpmInt(scanner, width) != PPM_INT || readPpmInt(scanner, height) != PPM_INT) {
+    cout << "Error: read non-integer value" << endl;
+    return false;
+  }
+  if (width <= 0 || height <= 0) {
+    cout << "Error: invalid image size " << width << "x" << height << endl;
+    return false;
+  }
+  return true;
+}
+
+bool loadImageHeader(string filename, int& width, int& height) {
+  //only the pages holding the header are ever touched
+  MappedFile file(filename);
+  if (!file.opened) {
+    cout << "Error: failed to open input file - " << filename << endl;
+    return false;
+  }
+  PpmScanner scanner = { file.data, file.data + file.size };
+  bool binary;
+  return readPpmSize(scanner, binary, width, height);
+}
+
+bool loadImage(string filename, Image* image, int maxval) {
+
+/*
+- this function will map a P3 or P6 file into memory and load its pixels, row by row, into the image
+- if loading was successful, return true, otherwise false
+- throw errors if:
+  1. too many color values
+  2. color values < 0 or > 255 (P6 values above maxval)
+  3. failed to open file
+  4. file type isnt P3 or P6
+  5. contains non integer value
+  6. not enough color values
+  7. input width/height doesnt match value in file
+*/
+
+  PROFILE_PHASE(PHASE_LOAD);
+  MappedFile file(filename);
+  if (!file.opened) {
+    cout << "Error: failed to open input file - " << filename << endl;
+    return false;
+  }
+
+  PROFILE_COUNT(COUNTER_BYTES_READ, static_cast<long long>(file.size));
+  PpmScanner scanner = { file.data, file.data + file.size };
+  bool binary;
+  int w, h, size;
+  if (!readPpmSize(scanner, binary, w, h)) {
+    return false;
+  }
+
+  //test if the width and height match the values in the file
+  if(w != image->width){
+    cout << "Error: input width (" << image->width << ") does not match value in file ("  << w << ")" << endl;
+    return false;
+  }
+  if(h != image->height){
+    cout << "Error: input height (" << image->height << ") does not match value in file ("  << h << ")" << endl;
+    return false;
+  }
+
+  //check if the max color value is a valid number
+  if (readPpmInt(scanner, size) != PPM_INT) {
+    cout << "Error: read non-integer value" << endl;
+    return false;
+  }
+  if ((!binary && size != 255) || size <= 0 || size > 65535) {
+    cout << "Error invalid color value" << endl;
+    return false;
+  }
+
+  if (maxval <= 0 || maxval > 65535) {
+    cout << "Error: invalid sample range " << maxval << endl;
+    return false;
+  }
+  if (!binary) {
+    return loadAsciiPixels(scanner, image, maxval);
+  }
+
+  //exactly one whitespace byte separates the header from the raw samples
+  if (scanner.cursor == scanner.end) {
+    cout << "Error: not enough color values" << endl;
+    return false;
+  }
+  const char* body = scanner.cursor + 1;
+  return loadBinaryPixels(body, static_cast<size_t>(scanner.end - body), image, size, maxval);
+}
+
+//longest text a pixel can turn into: three ints of up to 11 characters plus separators
+static const int MAX_PIXEL_TEXT = 36;
+//rows formatted per thread before the writes catch up
+static const size_t OUTPUT_CHUNK_BYTES = 1 << 20;
+
+//write the whole buffer, retrying short writes
+static bool writeAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(fd, data, size);
+    if (written <= 0) {
+      return false;
+    }
+    PROFILE_COUNT(COUNTER_BYTES_WRITTEN, written);
+    data += written;
+    size -= static_cast<size_t>(written);
+  }
+  return true;
+}
+
+//decimal text of 0-255 followed by a space, so in-range samples are one 4 byte copy
+struct SampleText {
+  char text[4];
+  int length;
+};
+
+static vector<SampleText> makeSampleTexts() {
+  vector<SampleText> texts(256);
+  for (int value = 0; value < 256; ++value) {
+    char* end = to_chars(texts[value].text, texts[value].text + 4, value).ptr;
+    *end++ = ' ';
+    texts[value].length = static_cast<int>(end - texts[value].text);
+  }
+  return texts;
+}
+
+static const vector<SampleText> sampleTexts = makeSampleTexts();
+
+static inline char* formatSample(int value, char* out, char* limit) {
+  if (value >= 0 && value < 256) {
+    memcpy(out, sampleTexts[value].text, 4);
+    return out + sampleTexts[value].length;
+  }
+  out = to_chars(out, limit, value).ptr;
+  *out++ = ' ';
+  return out;
+}
+
+//format one row into out and return the end of what was written
+static char* formatRow(const Pixel* line, int width, bool binary, int maxval, char* out) {
+  if (binary && maxval < 256) {
+    for (int col = 0; col < width; ++col) {
+      *out++ = static_cast<char>(max(0, min(maxval, line[col].r)));
+      *out++ = static_cast<char>(max(0, min(maxval, line[col].g)));
+      *out++ = static_cast<char>(max(0, min(maxval, line[col].b)));
+    }
+    return out;
+  }
+  if (binary) {
+    //two bytes per sample, most significant first
+    for (int col = 0; col < width; ++col) {
+      int samples[3] = { line[col].r, line[col].g, line[col].b };
+      for (int sample : samples) {
+        sample = max(0, min(maxval, sample));
+        *out++ = static_cast<char>(sample >> 8);
+        *out++ = static_cast<char>(sample & 0xff);
+      }
+    }
+    return out;
+  }
+  char* limit = out + static_cast<size_t>(width) * MAX_PIXEL_TEXT;
+  for (int col = 0; col < width; ++col) {
+    out = formatSample(max(0, min(maxval, line[col].r)), out, limit);
+    out = formatSample(max(0, min(maxval, line[col].g)), out, limit);
+    out = formatSample(max(0, min(maxval, line[col].b)), out, limit);
+  }
+  //the last separator ends the line instead
+  out[-1] = '\n';
+  return out;
+}
+
+bool outputImage(string filename, const Image* image, PpmFormat format, int maxval) {
+  PROFILE_PHASE(PHASE_OUTPUT);
+
+  //declare variables
+  int width = image->width;
+  int height = image->height;
+
+  //.pnm files default to binary, everything else to the ASCII format loadImage was written for
+  if (format == PPM_AUTO) {
+    bool pnm = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".pnm") == 0;
+    format = pnm ? PPM_BINARY : PPM_ASCII;
+  }
+  bool binary = (format == PPM_BINARY);
+  if (maxval <= 0 || maxval > 65535) {
+    cout << "Error: invalid sample range " << maxval << endl;
+    return false;
+  }
+
+  //write to a temporary name next to the file and rename it into place once every byte is
+  //out, so a failed write leaves no truncated image behind
+  string temporary = filename + "." + to_string(hash<thread::id>()(this_thread::get_id())) + ".tmp";
+  int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    cout << "Error: failed to open output file - " << filename << endl;
+    return false;
+  }
+
+  string header = string(binary ? "P6" : "P3") + "\n" + to_string(width) + " " + to_string(height) + "\n" + to_string(maxval) + "\n";
+  bool ok = writeAll(fd, header.data(), header.size());
+
+  //rows are formatted in parallel, one chunk of rows per thread, and each round of
+  //chunks goes out in order with one write per chunk
+  size_t rowBytes = static_cast<size_t>(width) * (binary ? (maxval < 256 ? 3 : 6) : MAX_PIXEL_TEXT);
+  int chunkRows = static_cast<int>(max<size_t>(1, OUTPUT_CHUNK_BYTES / rowBytes));
+  int chunks = max(1, threadCount());
+  vector<vector<char>> buffers(chunks, vector<char>(rowBytes * chunkRows));
+  vector<size_t> used(chunks);
+
+  for (int first = 0; ok && first < height; first += chunkRows * chunks) {
+    int round = min(chunks, (height - first + chunkRows - 1) / chunkRows);
+    parallelJobs(round, [&](int chunk) {
+      int start = first + chunk * chunkRows;
+      int stop = min(height, start + chunkRows);
+      char* begin = buffers[chunk].data();
+      char* out = begin;
+      for (int row = start; row < stop; ++row) {
+        out = formatRow(imageRow(image, row), width, binary, maxval, out);
+      }
+      used[chunk] = static_cast<size_t>(out - begin);
+    });
+    for (int chunk = 0; ok && chunk < round; ++chunk) {
+      ok = writeAll(fd, buffers[chunk].data(), used[chunk]);
+    }
+  }
+
+  if (close(fd) != 0 || !ok || std::rename(temporary.c_str(), filename.c_str()) != 0) {
+    unlink(temporary.c_str());
+    cout << "Error: failed to write output file - " << filename << endl;
+    return false;
+  }
+  return true;
+}
+
+//integer square, std::pow would round-trip every difference through a double
+static inline int square(int value) {
+  return value * value;
+}
+
+//squared colour difference of two pixels, one term of the dual-gradient energy
+static inline int pixelGradient(const Pixel& a, const Pixel& b) {
+  return square(a.r - b.r) + square(a.g - b.g) + square(a.b - b.b);
+}
+
+//dual gradient energy function = deltax^2(x,y) + deltay^2(x,y), wrapping around at the borders
+//pixel (x, y) is imageRow(image, y)[x]  ****width is going left to right, height is going top to bottom****
+int energy(const Image* image, int x, int y) {
+  return dualGradientEnergy(image, x, y, pixelGradient);
+}
+
+//the row kernels treat a row of Pixels as a flat array of 3 * width ints
+static_assert(sizeof(Pixel) == 3 * sizeof(int), "Pixel must be three packed ints");
+
+//interior columns [1, width - 1) of one row, plain C++
+//above/below are the rows energy() compares against (the row itself when height < 3)
+static void energyRowScalar(const Pixel* row, const Pixel* above, const Pixel* below, int width, int* out) {
+  for (int col = 1; col < width - 1; ++col) {
+    out[col] = square(row[col + 1].r - row[col - 1].r) + square(row[col + 1].g - row[col - 1].g)
+             + square(row[col + 1].b - row[col - 1].b) + square(below[col].r - above[col].r)
+             + square(below[col].g - above[col].g) + square(below[col].b - above[col].b);
+  }
+}
+
+#ifdef SEAM_X86_SIMD
+//4 pixels (12 ints, three 128 bit lanes) per step
+__attribute__((target("sse4.1")))
+static void energyRowSSE4(const Pixel* row, const Pixel* above, const Pixel* below, int width, int* out) {
+  const int* center = reinterpret_cast<const int*>(row);
+  const int* up = reinterpret_cast<const int*>(above);
+  const int* down = reinterpret_cast<const int*>(below);
+  int col = 1;
+  for (; col + 4 <= width - 1; col += 4) {
+    alignas(16) int squares[12];
+    for (int lane = 0; lane < 12; lane += 4) {
+      int k = 3 * col + lane;
+      __m128i dx = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(center + k + 3)),
+                                 _mm_loadu_si128(reinterpret_cast<const __m128i*>(center + k - 3)));
+      __m128i dy = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(down + k)),
+                                 _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + k)));
+      __m128i sum = _mm_add_epi32(_mm_mullo_epi32(dx, dx), _mm_mullo_epi32(dy, dy));
+      _mm_store_si128(reinterpret_cast<__m128i*>(squares + lane), sum);
+    }
+    for (int i = 0; i < 4; ++i) {
+      out[col + i] = squares[3 * i] + squares[3 * i + 1] + squares[3 * i + 2];
+    }
+  }
+  //whatever doesn't fill a whole step
+  energyRowScalar(row + col - 1, above + col - 1, below + col - 1, width - col + 1, out + col - 1);
+}
+
+//8 pixels (24 ints, three 256 bit lanes) per step
+__attribute__((target("avx2")))
+static void energyRowAVX2(const Pixel* row, const Pixel* above, const Pixel* below, int width, int* out) {
+  const int* center = reinterpret_cast<const int*>(row);
+  const int* up = reinterpret_cast<const int*>(above);
+  const int* down = reinterpret_cast<const int*>(below);
+  int col = 1;
+  for (; col + 8 <= width - 1; col += 8) {
+    alignas(32) int squares[24];
+    for (int lane = 0; lane < 24; lane += 8) {
+      int k = 3 * col + lane;
+      __m256i dx = _mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(center + k + 3)),
+                                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(center + k - 3)));
+      __m256i dy = _mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(down + k)),
+                                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(up + k)));
+      __m256i sum = _mm256_add_epi32(_mm256_mullo_epi32(dx, dx), _mm256_mullo_epi32(dy, dy));
+      _mm256_store_si256(reinterpret_cast<__m256i*>(squares + lane), sum);
+    }
+    for (int i = 0; i < 8; ++i) {
+      out[col + i] = squares[3 * i] + squares[3 * i + 1] + squares[3 * i + 2];
+    }
+  }
+  //whatever doesn't fill a whole step
+  energyRowScalar(row + col - 1, above + col - 1, below + col - 1, width - col + 1, out + col - 1);
+}
+#endif
+
+static bool energyBackendSupported(EnergyBackend backend) {
+#ifdef SEAM_X86_SIMD
+  __builtin_cpu_init(); // may run before main while static backends are being set up
+  if (backend == ENERGY_AVX2) {
+    return __builtin_cpu_supports("avx2");
+  }
+  if (backend == ENERGY_SSE4) {
+    return __builtin_cpu_supports("sse4.1");
+  }
+#endif
+  return backend == ENERGY_SCALAR;
+}
+
+static EnergyBackend detectEnergyBackend() {
+  if (energyBackendSupported(ENERGY_AVX2)) {
+    return ENERGY_AVX2;
+  }
+  if (energyBackendSupported(ENERGY_SSE4)) {
+    return ENERGY_SSE4;
+  }
+  return ENERGY_SCALAR;
+}
+
+static EnergyBackend selectedBackend = detectEnergyBackend();
+
+EnergyBackend energyBackend() {
+  return selectedBackend;
+}
+
+bool setEnergyBackend(EnergyBackend backend) {
+  if (!energyBackendSupported(backend)) {
+    return false;
+  }
+  selectedBackend = backend;
+  return true;
+}
+
+void computeEnergyRow(const Image* image, int y, int* out) {
+  int width = image->width;
+  auto interior = [&](const Pixel* row, const Pixel* above, const Pixel* below, int* line) {
+    switch (selectedBackend) {
+#ifdef SEAM_X86_SIMD
+      case ENERGY_AVX2:
+        energyRowAVX2(row, above, below, width, line);
+        break;
+      case ENERGY_SSE4:
+        energyRowSSE4(row, above, below, width, line);
+        break;
+#endif
+      default:
+        energyRowScalar(row, above, below, width, line);
+        break;
+    }
+  };
+  dualGradientRow(image, y, out, interior, [&](int x, int row) { return energy(image, x, row); });
+}
+
+//energy map with room for width x height values, contents undefined
+EnergyMap* allocateEnergyMap(int width, int height, int stride) {
+  size_t bytes = sizeof(int) * static_cast<size_t>(stride) * static_cast<size_t>(height);
+
+  int* values = static_cast<int*>(::operator new(bytes, std::align_val_t(64), std::nothrow));
+  if (values == nullptr) { // failed to allocate
+    return nullptr;
+  }
+
+  EnergyMap* energies = new (std::nothrow) EnergyMap{ width, height, stride, values };
+  if (energies == nullptr) { // clean up and avoid memory leak
+    ::operator delete(values, std::align_val_t(64));
+    return nullptr;
+  }
+  PROFILE_ALLOCATE(values, static_cast<long long>(bytes));
+  return energies;
+}
+
+//recompute every energy of the image into energies, which takes on the image's size
+static void fillEnergyMap(const Image* image, EnergyMap* energies) {
+  PROFILE_PHASE(PHASE_ENERGY);
+  energies->width = image->width;
+  energies->height = image->height;
+  parallelBlocks(image->height, rowsPerThread(image->width), [&](int first, int last) {
+    for (int row = first; row < last; ++row) {
+      computeEnergyRow(image, row, energyMapRow(energies, row));
+    }
+  });
+}
+
+EnergyMap* createEnergyMap(const Image* image) {
+  //energies share the image's stride so a row of pixels and its row of energies line up
+  EnergyMap* energies = allocateEnergyMap(image->width, image->height, image->stride);
+  if (energies == nullptr) {
+    return nullptr;
+  }
+
+  //the only full energy pass, everything after this is incremental
+  fillEnergyMap(image, energies);
+  return energies;
+}
+
+void deleteEnergyMap(EnergyMap* energies) {
+  if (energies == nullptr) {
+    return;
+  }
+  PROFILE_RELEASE(energies->values);
+  ::operator delete(energies->values, std::align_val_t(64));
+  delete energies;
+}
+
+void transposeImage(const Image* source, Image* destination) {
+  transposeTiles(source->pixels, source->stride, source->width, source->height, destination->pixels, destination->stride);
+  destination->width = source->height;
+  destination->height = source->width;
+}
+
+void transposeEnergyMap(const EnergyMap* source, EnergyMap* destination) {
+  transposeTiles(source->values, source->stride, source->width, source->height, destination->values, destination->stride);
+  destination->width = source->height;
+  destination->height = source->width;
+}
+
+//destination must have been allocated at least as big as source
+static void copyEnergyMap(const EnergyMap* source, EnergyMap* destination) {
+  PROFILE_PHASE(PHASE_COPY);
+  destination->width = source->width;
+  destination->height = source->height;
+  parallelBlocks(source->height, rowsPerThread(source->width), [&](int first, int last) {
+    for (int row = first; row < last; ++row) {
+      memcpy(energyMapRow(destination, row), energyMapRow(source, row), sizeof(int) * source->width);
+    }
+  });
+}
+
+void copyImage(const Image* source, Image* destination) {
+  PROFILE_PHASE(PHASE_COPY);
+  destination->width = source->width;
+  destination->height = source->height;
+  parallelBlocks(source->height, rowsPerThread(source->width), [&](int first, int last) {
+    for (int row = first; row < last; ++row) {
+      memcpy(imageRow(destination, row), imageRow(source, row), sizeof(Pixel) * source->width);
+    }
+  });
+}
+
+//an image with room for the transpose of image, holding it; nullptr, with the error
+//printed, if there is no memory for one
+static Image* createTransposedImage(const Image* image) {
+  Image* transposed = createImage(image->height, image->width);
+  if (transposed == nullptr) {
+    cout << "Error: not enough memory to transpose a " << image->width << "x" << image->height << " image" << endl;
+    return nullptr;
+  }
+  transposeImage(image, transposed);
+  return transposed;
+}
+
+// implement for part 2
+
+// uncomment for part 2
+ 
+//complete this function first
+int loadVerticalSeam(const Image* image, int start_col, int* seam) {
+
+  //pixel (col, row) is imageRow(image, row)[col]
+  //seam if a dynamic array
+
+  //declare variables
+  int i;
+  int width = image->width;
+  int height = image->height;
+  int totalEnergy = energy(image, start_col, 0);
+  seam[0] = start_col;
+
+  /*
+  - traverse through image starting at first row of start_col
+  - traverse down the column by choosing the path of lowest energy
+  
+  PSEUDOCODE:
+  1. set seam for the first row to the starting column
+  */
+
+  for(i=1;i<height;i++){
+    //check if the width == 1
+    if(width == 1){
+      totalEnergy += energy(image, start_col, i);
+      seam[i] = start_col;
+    }
+    //for left side column
+    else if(start_col == 0){
+      //check same column
+      if(energy(image, start_col, i) < energy(image, start_col+1, i)){
+        totalEnergy += energy(image, start_col, i);
+        seam[i] = start_col;
+      }
+      //check column just right of start col
+      else if(energy(image, start_col+1, i) < energy(image, start_col, i)){
+        totalEnergy += energy(image, start_col+1, i);
+        start_col += 1;
+        seam[i] = start_col;
+      }
+      //check if both sides are tied
+      else if(energy(image, start_col, i) == energy(image, start_col+1, i)){
+        totalEnergy += energy(image, start_col, i );
+        seam[i] = start_col;
+      }
+    }
+    //for right side column
+    else if(start_col == width-1){
+      //check same column
+      if(energy(image, start_col, i) < energy(image, start_col-1, i)){
+        totalEnergy += energy(image, start_col, i);
+        seam[i] = start_col;
+      }
+      //check column just left of start col
+      else if(energy(image, start_col-1, i) < energy(image, start_col, i)){
+        totalEnergy += energy(image, start_col-1 , i);
+        start_col -= 1;
+        seam[i] = start_col;
+      }
+      else if(energy(image, start_col, i ) == energy(image, start_col-1, i)){
+        totalEnergy += energy(image, start_col, i );
+        seam[i] = start_col;
+      }
+    }
+    //for middle columns
+    else{
+      //check if middle pixel has the lowest energy
+      if(energy(image, start_col, i) < energy(image, start_col+1, i) && energy(image, start_col, i) < energy(image, start_col-1, i)){
+        totalEnergy += energy(image, start_col, i);
+        seam[i] = start_col;
+        //start_col doesnt change
+      }
+      //check if right pixel has the lowest energy
+      else if(energy(image, start_col+1, i) < energy(image, start_col, i) && energy(image, start_col+1, i) < energy(image, start_col-1, i)){
+        totalEnergy += energy(image, start_col+1, i);
+        start_col += 1;
+        seam[i] = start_col;
+      }
+      //check if the left pixel has the lowest energy
+      else if(energy(image, start_col-1, i) < energy(image, start_col, i) && energy(image, start_col-1, i) < energy(image, start_col+1, i)){
+          totalEnergy += energy(image, start_col-1, i);
+          start_col -= 1;
+          seam[i] = start_col;
+      }
+      //check if start col ties with right col
+      else if(energy(image, start_col, i) < energy(image, start_col-1, i) && energy(image, start_col, i) == energy(image, start_col+1, i)){
+        totalEnergy += energy(image, start_col, i);
+        seam[i] = start_col;
+      }
+      //check if start_col ties with left col
+      else if(energy(image, start_col, i) < energy(image, start_col+1, i) && energy(image, start_col, i) == energy(image, start_col-1, i)){
+        totalEnergy += energy(image, start_col, i);
+        seam[i] = start_col;
+      }
+      //check if all three cols tie, it goes middle
+      else if(energy(image, start_col, i) == energy(image, start_col-1, i)  && energy(image, start_col-1, i) == energy(image, start_col+1, i)){
+        totalEnergy += energy(image, start_col, i);
+        seam[i] = start_col;
+      }
+      //check if left col ties with right col
+      else if(energy(image, start_col-1, i) < energy(image, start_col, i) && energy(image, start_col-1, i) == energy(image, start_col+1, i )){
+        totalEnergy += energy(image, start_col+1, i);
+        start_col += 1;
+        seam[i] = start_col;
+      }
+    }
+  }
+
+  return totalEnergy;
+}
+
+//optional
+//energy() is symmetric under transposition, so a horizontal seam is a vertical seam of the transpose
+int loadHorizontalSeam(const Image* image, int start_row, int* seam) {
+  Image* transposed = createTransposedImage(image);
+  if (transposed == nullptr) {
+    return -1;
+  }
+  int totalEnergy = loadVerticalSeam(transposed, start_row, seam);
+  deleteImage(transposed);
+  return totalEnergy;
+}
+
+//stride createImage would give an image this wide
+static int strideFor(int width) {
+  return (width + 15) / 16 * 16;
+}
+
+struct CarveContext {
+  CarveContext()
+      : cost(), halo(), costRow(), costEnergies(nullptr), costWidth(0), costHeight(0), costStride(0), costRetained(false),
+        levels(), levelCapacity(), coarse(), centers(), seam(), horizontalSeam(), energies(nullptr), energyCapacity(0), transposedEnergies(nullptr), transposedEnergyCapacity(0),
+        transposed(nullptr), transposedCapacity(0), seed(nullptr), seedPixels(nullptr) {}
+  ~CarveContext() {
+    for (EnergyMap* level : levels) {
+      deleteEnergyMap(level);
+    }
+    deleteEnergyMap(energies);
+    deleteEnergyMap(transposedEnergies);
+    //the library's contexts never carve through an Image, and must not print
+    if (transposed != nullptr) {
+      deleteImage(transposed);
+    }
+  }
+  CarveContext(const CarveContext&) = delete;
+  CarveContext& operator=(const CarveContext&) = delete;
+
+  vector<long long> cost;        // cumulative-cost table, or the banded table of the pyramid search
+  vector<long long> halo;        // two scratch rows per thread of the tiled cost table
+  vector<long long> costRow;     // updateVerticalCost: one recomputed row
+  const EnergyMap* costEnergies; // cost is the DP table of these energies, costWidth x costHeight
+  int costWidth;                 // with a row stride of costStride; nullptr when it is not
+  int costHeight;
+  int costStride;
+  bool costRetained;             // updateVerticalCost brought it up to date after a removal
+  vector<EnergyMap*> levels;     // pyramid levels, finest first
+  vector<size_t> levelCapacity;  // values each level was allocated with
+  vector<int> coarse;            // pyramid search: the seam on the level above
+  vector<int> centers;           // and where it lands on the level being searched
+  vector<int> seam;
+  vector<int> horizontalSeam;    // retargetImage keeps one seam of each direction
+  EnergyMap* energies;
+  size_t energyCapacity;
+  EnergyMap* transposedEnergies; // retargetImage searches horizontal seams on these
+  size_t transposedEnergyCapacity;
+  Image* transposed;             // carveHorizontalSeams carves this
+  size_t transposedCapacity;
+  const EnergyMap* seed;         // seedEnergies: energies of the image whose pixels are at
+  const Pixel* seedPixels;       // seedPixels, for the next carve to start from
+};
+
+CarveContext* createCarveContext() {
+  return new (std::nothrow) CarveContext();
+}
+
+void deleteCarveContext(CarveContext* context) {
+  delete context;
+}
+
+void seedEnergies(CarveContext* context, const Image* image, const EnergyMap* energies) {
+  context->seed = image != nullptr ? energies : nullptr;
+  context->seedPixels = image != nullptr ? image->pixels : nullptr;
+}
+
+//*map resized to width x height with the given stride, reallocated only when it has
+//fewer than stride * height values
+static EnergyMap* reserveEnergyMap(EnergyMap*& map, size_t& capacity, int width, int height, int stride) {
+  size_t needed = static_cast<size_t>(stride) * height;
+  if (map == nullptr || capacity < needed) {
+    deleteEnergyMap(map);
+    map = allocateEnergyMap(width, height, stride);
+    capacity = map != nullptr ? needed : 0;
+    return map;
+  }
+  *map = { width, height, stride, map->values };
+  return map;
+}
+
+//the same for an image, with createImage's stride
+static Image* reserveImage(Image*& image, size_t& capacity, int width, int height) {
+  size_t needed = static_cast<size_t>(strideFor(width)) * height;
+  if (image == nullptr || capacity < needed) {
+    deleteImage(image);
+    image = createImage(width, height);
+    capacity = image != nullptr ? needed : 0;
+    return image;
+  }
+  *image = { width, height, strideFor(width), image->pixels };
+  return image;
+}
+
+//fill cost with the cheapest path energy from every pixel down to the bottom row
+//cost[row * width + col] = energy(col, row) + min of the three costs below it
+static void fillCostRow(const long long* below, const int* energyLine, long long* out, int first, int last, int width) {
+  for (int col = first; col < last; ++col) {
+    long long best = below[col];
+    if (col > 0 && below[col - 1] < best) {
+      best = below[col - 1];
+    }
+    if (col < width - 1 && below[col + 1] < best) {
+      best = below[col + 1];
+    }
+    out[col] = energyLine[col] + best;
+  }
+}
+
+//the table goes to context.cost
+static void fillVerticalCost(const EnergyMap* energies, CarveContext& context) {
+  PROFILE_PHASE(PHASE_SEARCH);
+  int width = energies->width;
+  int height = energies->height;
+  vector<long long>& cost = context.cost;
+  cost.resize(static_cast<size_t>(width) * height);
+  context.costEnergies = energies;
+  context.costWidth = width;
+  context.costHeight = height;
+  context.costStride = width;
+  context.costRetained = false;
+
+  //bottom row is just its own energy
+  long long* bottom = &cost[static_cast<size_t>(height - 1) * width];
+  const int* energyLine = energyMapRow(energies, height - 1);
+  for (int col = 0; col < width; ++col) {
+    bottom[col] = energyLine[col];
+  }
+
+  int teams = min(threadCount(), width / COLUMNS_PER_THREAD);
+  if (teams <= 1) {
+    //every other row adds the cheapest of the (up to) three pixels below it
+    for (int row = height - 2; row >= 0; --row) {
+      long long* current = &cost[static_cast<size_t>(row) * width];
+      fillCostRow(current + width, energyMapRow(energies, row), current, 0, width, width);
+    }
+    return;
+  }
+
+  //tiled version: each thread owns a block of columns and works through a band of rows
+  //before syncing. A cell depends on a cone that widens by one column per row, so the
+  //thread also computes a halo around its block (in its own scratch rows) that shrinks
+  //by one column per row and is gone by the top of the band. Only the block itself is
+  //written to the shared table, so the results are the same as the single-threaded loop.
+  int block = (width + teams - 1) / teams;
+  int band = max(8, block / 16);
+  vector<long long>& scratch = context.halo;
+  scratch.resize(static_cast<size_t>(teams) * 2 * width);
+
+  for (int last = height - 2; last >= 0; last -= band) {
+    int first = max(0, last - band + 1);
+    parallelJobs(teams, [&](int team) {
+      int blockStart = team * block;
+      int blockEnd = min(width, blockStart + block);
+      long long* rows[2] = { &scratch[static_cast<size_t>(team) * 2 * width],
+                             &scratch[static_cast<size_t>(team) * 2 * width + width] };
+      const long long* below = &cost[static_cast<size_t>(last + 1) * width];
+      for (int row = last; row >= first; --row) {
+        int reach = row - first;
+        int lo = max(0, blockStart - reach);
+        int hi = min(width, blockEnd + reach);
+        long long* out = rows[row & 1];
+        fillCostRow(below, energyMapRow(energies, row), out, lo, hi, width);
+        memcpy(&cost[static_cast<size_t>(row) * width + blockStart], out + blockStart, sizeof(long long) * (blockEnd - blockStart));
+        below = out;
+      }
+    });
+  }
+}
+
+//walk the cost table (rows stride values apart) from the top row down, writing the seam and
+//returning its energy; ties use the same rules as loadVerticalSeam: leftmost start column, then middle, right, left
+static long long traceVerticalSeam(const long long* cost, size_t stride, int width, int height, int* seam) {
+  PROFILE_PHASE(PHASE_SEARCH);
+  const long long* top = cost;
+  int col = 0;
+  for (int i = 1; i < width; ++i) {
+    if (top[i] < top[col]) {
+      col = i;
+    }
+  }
+  seam[0] = col;
+
+  for (int row = 1; row < height; ++row) {
+    const long long* current = cost + row * stride;
+    int next = col;
+    if (col < width - 1 && current[col + 1] < current[next]) {
+      next = col + 1;
+    }
+    if (col > 0 && current[col - 1] < current[next]) {
+      next = col - 1;
+    }
+    col = next;
+    seam[row] = col;
+  }
+
+  return top[seam[0]];
+}
+
+static int pyramidLevels = 2;
+static int pyramidBand = 8;
+
+void setPyramid(int levels, int band) {
+  pyramidLevels = max(0, levels);
+  pyramidBand = max(1, band);
+}
+
+//half-size copy of source: every value is the mean of a 2x2 block, a last odd row or
+//column averages the values it has. destination must be allocated big enough
+static void downsampleEnergyMap(const EnergyMap* source, EnergyMap* destination) {
+  int width = (source->width + 1) / 2;
+  int height = (source->height + 1) / 2;
+  destination->width = width;
+  destination->height = height;
+  parallelBlocks(height, rowsPerThread(source->width), [&](int first, int last) {
+    for (int row = first; row < last; ++row) {
+      const int* top = energyMapRow(source, 2 * row);
+      const int* bottom = 2 * row + 1 < source->height ? energyMapRow(source, 2 * row + 1) : top;
+      int* out = energyMapRow(destination, row);
+      //energies are at most 6 * 255^2, so four of them still fit in an int
+      int pairs = source->width / 2;
+      for (int col = 0; col < pairs; ++col) {
+        out[col] = (top[2 * col] + top[2 * col + 1] + bottom[2 * col] + bottom[2 * col + 1]) >> 2;
+      }
+      if (pairs < width) {
+        out[pairs] = (top[2 * pairs] + bottom[2 * pairs]) >> 1;
+      }
+    }
+  });
+}
+
+//minimum seam whose column in each row stays within band of centers[row], with the same
+//tie-breaking as traceVerticalSeam. cost is scratch: row r keeps columns centers[r] - band
+//to centers[r] + band, anything outside the window or the map is unreachable
+static long long traceBandedSeam(const EnergyMap* energies, const int* centers, int band, vector<long long>& cost, int* seam) {
+  const long long UNREACHABLE = LLONG_MAX / 2;
+  int width = energies->width;
+  int height = energies->height;
+  int span = 2 * band + 1;
+  cost.assign(static_cast<size_t>(height) * span, UNREACHABLE);
+
+  //cost of (row, col), unreachable outside the row's window
+  auto at = [&](int row, int col) {
+    int index = col - (centers[row] - band);
+    return (index >= 0 && index < span) ? cost[static_cast<size_t>(row) * span + index] : UNREACHABLE;
+  };
+
+  for (int row = height - 1; row >= 0; --row) {
+    const int* energyLine = energyMapRow(energies, row);
+    long long* current = &cost[static_cast<size_t>(row) * span];
+    int base = centers[row] - band;
+    for (int col = max(0, base); col < min(width, base + span); ++col) {
+      long long best = 0;
+      if (row < height - 1) {
+        best = min(at(row + 1, col), min(col > 0 ? at(row + 1, col - 1) : UNREACHABLE, col < width - 1 ? at(row + 1, col + 1) : UNREACHABLE));
+      }
+      if (best < UNREACHABLE) {
+        current[col - base] = energyLine[col] + best;
+      }
+    }
+  }
+
+  int col = max(0, centers[0] - band);
+  for (int i = col + 1; i < min(width, centers[0] - band + span); ++i) {
+    if (at(0, i) < at(0, col)) {
+      col = i;
+    }
+  }
+  seam[0] = col;
+  long long total = at(0, col);
+
+  for (int row = 1; row < height; ++row) {
+    int next = col;
+    if (col < width - 1 && at(row, col + 1) < at(row, next)) {
+      next = col + 1;
+    }
+    if (col > 0 && at(row, col - 1) < at(row, next)) {
+      next = col - 1;
+    }
+    col = next;
+    seam[row] = col;
+  }
+  return total;
+}
+
+//SEAM_PYRAMID: DP on the coarsest level, then at each finer level a banded search around
+//the seam from the level above, scaled up by two in both directions
+//the levels stay in context for the next seam
+static long long tracePyramidSeam(const EnergyMap* energies, CarveContext& context, int* seam) {
+  PROFILE_PHASE(PHASE_SEARCH);
+  int depth = 0;
+  const EnergyMap* coarsest = energies;
+  while (depth < pyramidLevels && coarsest->width / 2 > 4 * pyramidBand && coarsest->height >= 2) {
+    int width = (coarsest->width + 1) / 2;
+    if (depth == static_cast<int>(context.levels.size())) {
+      context.levels.push_back(nullptr);
+      context.levelCapacity.push_back(0);
+    }
+    EnergyMap* next = reserveEnergyMap(context.levels[depth], context.levelCapacity[depth], width, (coarsest->height + 1) / 2, strideFor(width));
+    if (next == nullptr) {
+      break;
+    }
+    downsampleEnergyMap(coarsest, next);
+    coarsest = next;
+    ++depth;
+  }
+
+  if (depth == 0) {
+    fillVerticalCost(energies, context);
+    return traceVerticalSeam(context.cost.data(), energies->width, energies->width, energies->height, seam);
+  }
+
+  vector<int>& coarse = context.coarse;
+  vector<int>& centers = context.centers;
+  coarse.resize(coarsest->height);
+  fillVerticalCost(coarsest, context);
+  traceVerticalSeam(context.cost.data(), coarsest->width, coarsest->width, coarsest->height, coarse.data());
+
+  long long total = 0;
+  for (int level = depth - 1; level >= 0; --level) {
+    const EnergyMap* finer = level > 0 ? context.levels[level - 1] : energies;
+    centers.resize(finer->height);
+    for (int row = 0; row < finer->height; ++row) {
+      centers[row] = min(finer->width - 1, 2 * coarse[row / 2] + 1);
+    }
+    if (level > 0) {
+      coarse.resize(finer->height);
+      traceBandedSeam(finer, centers.data(), pyramidBand, context.cost, coarse.data());
+    }
+    else {
+      total = traceBandedSeam(finer, centers.data(), pyramidBand, context.cost, seam);
+    }
+  }
+  return total;
+}
+
+//cheapest vertical seam of energies by the DP or the pyramid, written to seam; returns its energy
+static long long searchVerticalSeam(const EnergyMap* energies, SeamMode mode, CarveContext& context, int* seam) {
+  if (mode == SEAM_PYRAMID) {
+    long long total = tracePyramidSeam(energies, context, seam);
+    context.costEnergies = nullptr;
+    return total;
+  }
+  bool current = context.costRetained && context.costEnergies == energies &&
+                 context.costWidth == energies->width && context.costHeight == energies->height;
+  if (!current) {
+    fillVerticalCost(energies, context);
+  }
+  context.costRetained = false;
+  return traceVerticalSeam(context.cost.data(), context.costStride, energies->width, energies->height, seam);
+}
+
+long long traceMinVerticalSeam(const EnergyMap* energies, int* seam, SeamMode mode, CarveContext* context) {
+  if (mode == SEAM_GREEDY) {
+    mode = SEAM_DP;
+  }
+  if (context != nullptr) {
+    return searchVerticalSeam(energies, mode, *context, seam);
+  }
+  CarveContext owned;
+  return searchVerticalSeam(energies, mode, owned, seam);
+}
+
+long long traceBandedVerticalSeam(const EnergyMap* energies, const int* centers, int band, int* seam, CarveContext* context) {
+  PROFILE_PHASE(PHASE_SEARCH);
+  band = max(0, band);
+  if (context == nullptr) {
+    vector<long long> cost;
+    return traceBandedSeam(energies, centers, band, cost, seam);
+  }
+  context->costEnergies = nullptr;
+  return traceBandedSeam(energies, centers, band, context->cost, seam);
+}
+
+//up to MAX_SPANS sorted, disjoint column spans [first, last) of one row
+struct ColumnSpans {
+  static const int MAX_SPANS = 4;
+  int count;
+  int first[MAX_SPANS + 1];
+  int last[MAX_SPANS + 1];
+};
+
+//add [first, last) to spans, merging it with the spans it touches; past MAX_SPANS the two
+//closest spans merge, so the set can only grow, never lose a column
+static void addSpan(ColumnSpans& spans, int first, int last) {
+  if (first >= last) {
+    return;
+  }
+  int at = spans.count;
+  while (at > 0 && spans.first[at - 1] > first) {
+    spans.first[at] = spans.first[at - 1];
+    spans.last[at] = spans.last[at - 1];
+    --at;
+  }
+  spans.first[at] = first;
+  spans.last[at] = last;
+  ++spans.count;
+
+  int merged = 0;
+  for (int i = 1; i < spans.count; ++i) {
+    if (spans.first[i] <= spans.last[merged]) {
+      spans.last[merged] = max(spans.last[merged], spans.last[i]);
+    }
+    else {
+      ++merged;
+      spans.first[merged] = spans.first[i];
+      spans.last[merged] = spans.last[i];
+    }
+  }
+  spans.count = merged + 1;
+
+  if (spans.count > ColumnSpans::MAX_SPANS) {
+    int closest = 0;
+    for (int i = 1; i + 1 < spans.count; ++i) {
+      if (spans.first[i + 1] - spans.last[i] < spans.first[closest + 1] - spans.last[closest]) {
+        closest = i;
+      }
+    }
+    spans.last[closest] = spans.last[closest + 1];
+    for (int i = closest + 1; i + 1 < spans.count; ++i) {
+      spans.first[i] = spans.first[i + 1];
+      spans.last[i] = spans.last[i + 1];
+    }
+    --spans.count;
+  }
+}
+
+void updateVerticalCost(const EnergyMap* energies, const int* removedSeam, CarveContext* context) {
+  int width = energies->width;
+  int height = energies->height;
+  if (context == nullptr) {
+    return;
+  }
+  if (context->costEnergies != energies || context->costWidth != width + 1 || context->costHeight != height) {
+    //not the table of these energies before the removal: the next search fills it from scratch
+    context->costEnergies = nullptr;
+    return;
+  }
+  if (width < 3 || height < 3) {
+    fillVerticalCost(energies, *context);
+    context->costRetained = true;
+    return;
+  }
+
+  PROFILE_PHASE(PHASE_SEARCH);
+  long long* cost = context->cost.data();
+  size_t stride = context->costStride;
+  //close the gap the seam left in every row, like the energies: the values right of it
+  //move one column left and are still the costs of the same pixels
+  parallelBlocks(height, rowsPerThread(width), [&](int first, int last) {
+    for (int row = first; row < last; ++row) {
+      long long* line = cost + row * stride;
+      int col = removedSeam[row];
+      memmove(line + col, line + col + 1, sizeof(long long) * (width - col));
+    }
+  });
+
+  //a cell only changes if its energy did, if the seam ran between it and the cells below it
+  //(which shifts which pixels those are), or if one of those three cells changed. The first two
+  //lie within one column of the seams through the row and the rows next to it, plus the border
+  //columns whose energies wrap around (see updateEnergiesAfterVerticalSeam); the last widens
+  //the region by one column a row going up, but only from the cells whose cost really changed
+  vector<long long>& scratch = context->costRow;
+  scratch.resize(width);
+  ColumnSpans changed = {};
+  for (int row = height - 1; row >= 0; --row) {
+    ColumnSpans dirty = {};
+    int lowest = removedSeam[row];
+    int highest = removedSeam[row];
+    int neighbours[2] = { (row - 1 + height) % height, (row + 1) % height };
+    for (int neighbour : neighbours) {
+      lowest = min(lowest, removedSeam[neighbour]);
+      highest = max(highest, removedSeam[neighbour]);
+    }
+    addSpan(dirty, max(0, lowest - 1), min(width, highest + 1));
+    addSpan(dirty, 0, 1);
+    addSpan(dirty, width - 1, width);
+    for (int i = 0; i < changed.count; ++i) {
+      addSpan(dirty, max(0, changed.first[i] - 1), min(width, changed.last[i] + 1));
+    }
+
+    long long* line = cost + row * stride;
+    const int* energyLine = energyMapRow(energies, row);
+    changed.count = 0;
+    for (int i = 0; i < dirty.count; ++i) {
+      int first = dirty.first[i];
+      int last = dirty.last[i];
+      if (row == height - 1) {
+        for (int col = first; col < last; ++col) {
+          scratch[col] = energyLine[col];
+        }
+      }
+      else {
+        fillCostRow(line + stride, energyLine, scratch.data(), first, last, width);
+      }
+      int firstChanged = last;
+      int lastChanged = first;
+      for (int col = first; col < last; ++col) {
+        if (scratch[col] != line[col]) {
+          firstChanged = min(firstChanged, col);
+          lastChanged = col + 1;
+          line[col] = scratch[col];
+        }
+      }
+      addSpan(changed, firstChanged, lastChanged);
+    }
+  }
+  context->costWidth = width;
+  context->costRetained = true;
+}
+
+//complete this function second
+int* findMinVerticalSeam(const Image* image, SeamMode mode, const EnergyMap* energies) {
+
+  int i;
+  int height = image->height;
+
+  if (mode != SEAM_GREEDY) {
+    //one pass over the image builds the table, one walk down it builds the seam
+    //without a persistent map the energies are computed once here for this seam only
+    EnergyMap* scratch = nullptr;
+    if (energies == nullptr) {
+      scratch = createEnergyMap(image);
+      energies = scratch;
+    }
+    CarveContext context;
+    int* seam = createSeam(height);
+    searchVerticalSeam(energies, mode, context, seam);
+    deleteEnergyMap(scratch);
+    return seam;
+  }
+
+  //SEAM_GREEDY: try a greedy walk from every column and keep the cheapest one
+  PROFILE_PHASE(PHASE_SEARCH);
+  int min = INT32_MAX;
+  int* seam = new int[height];
+  int* temp = new int[height];
+
+  for(i=0;i<image->width;i++){
+    int total = loadVerticalSeam(image, i, seam);
+    if(total < min){
+      min = total;
+      //keep the best seam so far, temp becomes the scratch buffer for the next column
+      int* best = seam;
+      seam = temp;
+      temp = best;
+    }
+  } 
+
+  //deallocate seam
+  delete[] seam;
+
+  return temp;
+}
+
+//optional
+//runs the vertical engine on the transposed energies; carving many horizontal seams
+//should go through carveHorizontalSeams, which only transposes the image twice in total
+int* findMinHorizontalSeam(const Image* image, SeamMode mode, const EnergyMap* energies) {
+  if (mode == SEAM_GREEDY) {
+    Image* transposed = createTransposedImage(image);
+    if (transposed == nullptr) {
+      return nullptr;
+    }
+    int* seam = findMinVerticalSeam(transposed, SEAM_GREEDY);
+    deleteImage(transposed);
+    return seam;
+  }
+
+  EnergyMap* owned = nullptr;
+  if (energies == nullptr) {
+    owned = createEnergyMap(image);
+    energies = owned;
+  }
+  EnergyMap* transposed = energies != nullptr ? allocateEnergyMap(image->height, image->width, strideFor(image->height)) : nullptr;
+  if (transposed == nullptr) {
+    cout << "Error: not enough memory to transpose the energies of a " << image->width << "x" << image->height << " image" << endl;
+    deleteEnergyMap(owned);
+    return nullptr;
+  }
+  transposeEnergyMap(energies, transposed);
+  deleteEnergyMap(owned);
+
+  CarveContext context;
+  int* seam = createSeam(image->width);
+  searchVerticalSeam(transposed, mode, context, seam);
+
+  deleteEnergyMap(transposed);
+  return seam;
+}
+
+//recompute energies[row][col] for every col in [first, last)
+static void refreshEnergies(const Image* image, EnergyMap* energies, int row, int first, int last) {
+  int* line = energyMapRow(energies, row);
+  for (int col = first; col < last; ++col) {
+    line[col] = energy(image, col, row);
+  }
+}
+
+//the pixels refreshAfterVerticalSeam picks, recomputed in place
+static void updateEnergiesAfterVerticalSeam(const Image* image, EnergyMap* energies, const int* verticalSeam) {
+  PROFILE_PHASE(PHASE_ENERGY);
+  energies->width = image->width; // already one narrower than when the seam was found
+  refreshAfterVerticalSeam(image->width, image->height, verticalSeam, [&](int row, int first, int last) {
+    refreshEnergies(image, energies, row, first, last);
+  });
+}
+
+//complete this function third
+void removeVerticalSeam(Image* image, const int* verticalSeam, EnergyMap* energies) {
+  PROFILE_PHASE(PHASE_REMOVE);
+  PROFILE_COUNT(COUNTER_SEAMS_REMOVED, 1);
+  //slide everything right of the seam one pixel left
+  int width = image->width;
+  closeVerticalSeam(image, verticalSeam, image, energies);
+  image->width = width - 1;
+
+  if (energies != nullptr) {
+    updateEnergiesAfterVerticalSeam(image, energies, verticalSeam);
+  }
+}
+
+//follow the cost table down from start without touching any pixel already taken by
+//another seam, using the same middle/right/left preference as traceVerticalSeam
+//returns false if the walk gets boxed in
+static bool traceDisjointSeam(const vector<long long>& cost, const vector<char>& taken, int width, int height, int start, int* seam) {
+  if (taken[start]) {
+    return false;
+  }
+  int col = start;
+  seam[0] = col;
+  for (int row = 1; row < height; ++row) {
+    const long long* current = &cost[static_cast<size_t>(row) * width];
+    const char* used = &taken[static_cast<size_t>(row) * width];
+    int candidates[3] = { col, col + 1, col - 1 };
+    int next = -1;
+    for (int candidate : candidates) {
+      if (candidate < 0 || candidate >= width || used[candidate]) {
+        continue;
+      }
+      if (next == -1 || current[candidate] < current[next]) {
+        next = candidate;
+      }
+    }
+    if (next == -1) {
+      return false;
+    }
+    col = next;
+    seam[row] = col;
+  }
+  return true;
+}
+
+int adaptiveSeamsPerPass(int width, int remaining) {
+  //at most 1/8 of what's left in one pass and never more than 1/32 of the width,
+  //so most of every pass still comes from an up-to-date cost table
+  int seams = min(remaining / 8, width / 32);
+  return max(1, seams);
+}
+
+int removeVerticalSeams(Image* image, int count, EnergyMap* energies) {
+  int width = image->width;
+  int height = image->height;
+  count = min(count, width - 1);
+  if (count <= 0) {
+    return 0;
+  }
+
+  EnergyMap* scratch = nullptr;
+  if (energies == nullptr) {
+    scratch = createEnergyMap(image);
+  }
+  CarveContext context;
+  fillVerticalCost(energies != nullptr ? energies : scratch, context);
+  deleteEnergyMap(scratch);
+  const vector<long long>& cost = context.cost;
+
+  //try start columns from cheapest to most expensive, keeping every seam that
+  //stays clear of the ones already picked
+  vector<int> starts(width);
+  for (int col = 0; col < width; ++col) {
+    starts[col] = col;
+  }
+  stable_sort(starts.begin(), starts.end(), [&](int a, int b) { return cost[a] < cost[b]; });
+
+  vector<char> taken(static_cast<size_t>(width) * height, 0);
+  vector<int> seams(static_cast<size_t>(count) * height);
+  int found = 0;
+  //the seam picks and the compaction are timed apart when profiling
+  {
+    PROFILE_PHASE(PHASE_SEARCH);
+    for (int i = 0; i < width && found < count; ++i) {
+      int* seam = &seams[static_cast<size_t>(found) * height];
+      if (!traceDisjointSeam(cost, taken, width, height, starts[i], seam)) {
+        continue;
+      }
+      for (int row = 0; row < height; ++row) {
+        taken[static_cast<size_t>(row) * width + seam[row]] = 1;
+      }
+      ++found;
+    }
+  }
+
+  {
+    //one sweep per row: slide each run of kept pixels left past every removed pixel before it
+    PROFILE_PHASE(PHASE_REMOVE);
+    PROFILE_COUNT(COUNTER_SEAMS_REMOVED, found);
+    parallelBlocks(height, rowsPerThread(width), [&](int first, int last) {
+      vector<int> removed(found);
+      for (int row = first; row < last; ++row) {
+        for (int i = 0; i < found; ++i) {
+          removed[i] = seams[static_cast<size_t>(i) * height + row];
+        }
+        sort(removed.begin(), removed.end());
+        Pixel* line = imageRow(image, row);
+        int write = removed[0];
+        for (int i = 0; i < found; ++i) {
+          int from = removed[i] + 1;
+          int to = (i + 1 < found) ? removed[i + 1] : width;
+          memmove(line + write, line + from, sizeof(Pixel) * (to - from));
+          write += to - from;
+        }
+      }
+    });
+  }
+  image->width = width - found;
+
+  //most rows changed in many places, so the map is refreshed in one pass instead of per seam
+  if (energies != nullptr) {
+    fillEnergyMap(image, energies);
+  }
+  return found;
+}
+
+//the pixels refreshAfterHorizontalSeam picks, recomputed in place
+static void updateEnergiesAfterHorizontalSeam(const Image* image, EnergyMap* energies, const int* horizontalSeam) {
+  PROFILE_PHASE(PHASE_ENERGY);
+  energies->height = image->height; // already one shorter than when the seam was found
+  refreshAfterHorizontalSeam(image->width, image->height, horizontalSeam, [&](int col, int first, int last) {
+    for (int row = first; row < last; ++row) {
+      energyMapRow(energies, row)[col] = energy(image, col, row);
+    }
+  });
+}
+
+//optional
+void removeHorizontalSeam(Image* image, const int* horizontalSeam, EnergyMap* energies) {
+  PROFILE_PHASE(PHASE_REMOVE);
+  PROFILE_COUNT(COUNTER_SEAMS_REMOVED, 1);
+  int width = image->width;
+  int height = image->height;
+
+  //shifting each column up would stride through memory, so sweep the rows in order
+  //instead and pull up every pixel at or below its column's seam from the row below
+  int top = *min_element(horizontalSeam, horizontalSeam + width);
+  parallelBlocks(width, max(1, rowsPerThread(height)), [&](int firstCol, int lastCol) {
+    for (int row = top; row < height - 1; ++row) {
+      Pixel* line = imageRow(image, row);
+      const Pixel* next = imageRow(image, row + 1);
+      int* energyLine = energies != nullptr ? energyMapRow(energies, row) : nullptr;
+      const int* nextEnergies = energies != nullptr ? energyMapRow(energies, row + 1) : nullptr;
+      for (int col = firstCol; col < lastCol; ++col) {
+        if (row >= horizontalSeam[col]) {
+          line[col] = next[col];
+          if (energyLine != nullptr) {
+            energyLine[col] = nextEnergies[col];
+          }
+        }
+      }
+    }
+  });
+
+  image->height = height - 1;
+
+  if (energies != nullptr) {
+    updateEnergiesAfterHorizontalSeam(image, energies, horizontalSeam);
+  }
+}
+
+int removeHorizontalSeams(Image* image, int count, EnergyMap* energies) {
+  //the batch engine works on columns, so run it on the transpose
+  Image* transposed = createTransposedImage(image);
+  if (transposed == nullptr) {
+    return 0;
+  }
+  int removed = removeVerticalSeams(transposed, count);
+  transposeImage(transposed, image);
+  deleteImage(transposed);
+
+  if (energies != nullptr) {
+    fillEnergyMap(image, energies);
+  }
+  return removed;
+}
+
+int carveVerticalSeams(Image* image, int targetWidth, int seamsPerPass, SeamMode mode) {
+  //no seam gets below one column, so a lower target would never be reached
+  targetWidth = max(1, targetWidth);
+  if (seamsPerPass == 1) {
+    CarveContext context;
+    return carveVerticalSeams(image, targetWidth, &context, mode);
+  }
+  int removed = 0;
+  EnergyMap* energies = createEnergyMap(image);
+  while (image->width > targetWidth) {
+    int remaining = image->width - targetWidth;
+    int count = seamsPerPass > 0 ? seamsPerPass : adaptiveSeamsPerPass(image->width, remaining);
+    int batch = removeVerticalSeams(image, min(count, remaining), energies);
+    if (batch == 0) {
+      break;
+    }
+    removed += batch;
+  }
+  deleteEnergyMap(energies);
+  return removed;
+}
+
+int carveHorizontalSeams(Image* image, int targetHeight, int seamsPerPass, SeamMode mode) {
+  targetHeight = max(1, targetHeight);
+  if (seamsPerPass == 1) {
+    CarveContext context;
+    return carveHorizontalSeams(image, targetHeight, &context, mode);
+  }
+  if (image->height <= targetHeight) {
+    return 0;
+  }
+  //transpose once, remove vertical seams with the row-major engine, transpose back
+  Image* transposed = createTransposedImage(image);
+  if (transposed == nullptr) {
+    return 0;
+  }
+  int removed = carveVerticalSeams(transposed, targetHeight, seamsPerPass, mode);
+  transposeImage(transposed, image);
+  deleteImage(transposed);
+  return removed;
+}
+
+//the first full energy map of a carve: copied from the context's seed when it was given for
+//this very image, computed otherwise. Either way the seed has then been used up
+static void fillStartEnergies(const Image* image, EnergyMap* energies, CarveContext& context) {
+  const EnergyMap* seed = context.seed;
+  bool seeded = seed != nullptr && context.seedPixels == image->pixels && seed->width == image->width && seed->height == image->height;
+  context.seed = nullptr;
+  context.seedPixels = nullptr;
+  if (!seeded) {
+    fillEnergyMap(image, energies);
+    return;
+  }
+  PROFILE_PHASE(PHASE_ENERGY);
+  energies->width = image->width;
+  energies->height = image->height;
+  for (int row = 0; row < image->height; ++row) {
+    copy(energyMapRow(seed, row), energyMapRow(seed, row) + image->width, energyMapRow(energies, row));
+  }
+}
+
+int carveVerticalSeams(Image* image, int targetWidth, CarveContext* context, SeamMode mode) {
+  if (image->width <= targetWidth) {
+    return 0;
+  }
+  EnergyMap* energies = reserveEnergyMap(context->energies, context->energyCapacity, image->width, image->height, image->stride);
+  if (energies == nullptr) {
+    return 0;
+  }
+  fillStartEnergies(image, energies, *context);
+  context->seam.resize(image->height);
+  int* seam = context->seam.data();
+  int removed = 0;
+  while (image->width > targetWidth) {
+    if (mode == SEAM_GREEDY) {
+      int* greedy = findMinVerticalSeam(image, SEAM_GREEDY);
+      copy(greedy, greedy + image->height, seam);
+      deleteSeam(greedy);
+    }
+    else {
+      searchVerticalSeam(energies, mode, *context, seam);
+    }
+    removeVerticalSeam(image, seam, energies);
+    if (mode == SEAM_DP && image->width > targetWidth) {
+      updateVerticalCost(energies, seam, context);
+    }
+    removed += 1;
+  }
+  return removed;
+}
+
+int carveHorizontalSeams(Image* image, int targetHeight, CarveContext* context, SeamMode mode) {
+  if (image->height <= targetHeight) {
+    return 0;
+  }
+  Image* transposed = reserveImage(context->transposed, context->transposedCapacity, image->height, image->width);
+  if (transposed == nullptr) {
+    return 0;
+  }
+  transposeImage(image, transposed);
+  int removed = carveVerticalSeams(transposed, targetHeight, context, mode);
+  transposeImage(transposed, image);
+  return removed;
+}
+
+//cheapest vertical seam given the image's energies, written to seam; returns its energy
+static long long bestVerticalSeam(const EnergyMap* energies, CarveContext& context, int* seam, SeamMode mode = SEAM_DP) {
+  return searchVerticalSeam(energies, mode, context, seam);
+}
+
+//cheapest horizontal seam, found by running the vertical search on the transposed energies
+static long long bestHorizontalSeam(const EnergyMap* energies, EnergyMap* transposed, CarveContext& context, int* seam, SeamMode mode = SEAM_DP) {
+  transposeEnergyMap(energies, transposed);
+  return searchVerticalSeam(transposed, mode, context, seam);
+}
+
+//each step removes whichever of the best vertical and best horizontal seam costs less
+static void retargetGreedy(Image* image, int targetWidth, int targetHeight, SeamMode mode, CarveContext& context, RetargetStats& stats) {
+  EnergyMap* energies = reserveEnergyMap(context.energies, context.energyCapacity, image->width, image->height, image->stride);
+  EnergyMap* transposed = reserveEnergyMap(context.transposedEnergies, context.transposedEnergyCapacity,
+                                           image->height, image->width, strideFor(image->height));
+  if (energies == nullptr || transposed == nullptr) {
+    return;
+  }
+  fillStartEnergies(image, energies, context);
+  vector<int>& verticalSeam = context.seam;
+  vector<int>& horizontalSeam = context.horizontalSeam;
+  verticalSeam.resize(image->height);
+  horizontalSeam.resize(image->width);
+
+  while (image->width > targetWidth || image->height > targetHeight) {
+    long long verticalCost = LLONG_MAX;
+    long long horizontalCost = LLONG_MAX;
+    if (image->width > targetWidth) {
+      verticalCost = bestVerticalSeam(energies, context, verticalSeam.data(), mode);
+    }
+    if (image->height > targetHeight) {
+      horizontalCost = bestHorizontalSeam(energies, transposed, context, horizontalSeam.data(), mode);
+    }
+    if (verticalCost <= horizontalCost) {
+      removeVerticalSeam(image, verticalSeam.data(), energies);
+      stats.energyRemoved += verticalCost;
+      stats.verticalSeams += 1;
+    }
+    else {
+      removeHorizontalSeam(image, horizontalSeam.data(), energies);
+      stats.energyRemoved += horizontalCost;
+      stats.horizontalSeams += 1;
+    }
+  }
+}
+
+//transport map: best[r][c] is the least energy needed to remove r rows and c columns,
+//min(best[r-1][c] + best horizontal seam of image(r-1, c), best[r][c-1] + best vertical
+//seam of image(r, c-1)). The table is filled a row at a time, keeping one image per
+//column of the table that gets updated in place from image(r-1, c) to image(r, c).
+//Each column image carries its own energy map, kept up to date by the seam removals like
+//every other carve, so no cell recomputes energies; the transposed map, the cost table and
+//the seams are one set of buffers reused for every cell. false if out of memory, with image
+//untouched
+static bool retargetOptimal(Image* image, int targetWidth, int targetHeight, RetargetStats& stats) {
+  int rows = image->height - targetHeight;
+  int cols = image->width - targetWidth;
+  vector<Image*> images(cols + 1, nullptr);
+  vector<EnergyMap*> energies(cols + 1, nullptr);
+  EnergyMap* transposed = allocateEnergyMap(image->height, image->width, strideFor(image->height));
+  bool allocated = transposed != nullptr;
+  for (int c = 0; c <= cols && allocated; ++c) {
+    images[c] = createImage(image->width, image->height);
+    energies[c] = images[c] != nullptr ? allocateEnergyMap(image->width, image->height, images[c]->stride) : nullptr;
+    allocated = energies[c] != nullptr;
+  }
+  auto release = [&]() {
+    deleteEnergyMap(transposed);
+    for (int c = 0; c <= cols; ++c) {
+      deleteEnergyMap(energies[c]);
+      if (images[c] != nullptr) {
+        deleteImage(images[c]);
+      }
+    }
+  };
+  if (!allocated) {
+    cout << "Error: not enough memory for the optimal order (" << cols + 1 << " copies of the image)" << endl;
+    release();
+    return false;
+  }
+
+  vector<long long> best(static_cast<size_t>(rows + 1) * (cols + 1));
+  CarveContext context;
+  vector<int> verticalSeam(image->height);
+  vector<int> horizontalSeam(image->width);
+
+  for (int r = 0; r <= rows; ++r) {
+    for (int c = 0; c <= cols; ++c) {
+      long long* cell = &best[static_cast<size_t>(r) * (cols + 1) + c];
+      if (r == 0 && c == 0) {
+        copyImage(image, images[0]);
+        fillEnergyMap(images[0], energies[0]);
+        *cell = 0;
+        continue;
+      }
+      //images[c] still holds image(r-1, c), images[c-1] already holds image(r, c-1)
+      long long fromAbove = LLONG_MAX;
+      long long fromLeft = LLONG_MAX;
+      if (r > 0) {
+        fromAbove = cell[-(cols + 1)] + bestHorizontalSeam(energies[c], transposed, context, horizontalSeam.data());
+      }
+      if (c > 0) {
+        fromLeft = cell[-1] + bestVerticalSeam(energies[c - 1], context, verticalSeam.data());
+      }
+      //ties go to the vertical seam, like the greedy order
+      if (fromLeft <= fromAbove) {
+        copyImage(images[c - 1], images[c]);
+        copyEnergyMap(energies[c - 1], energies[c]);
+        removeVerticalSeam(images[c], verticalSeam.data(), energies[c]);
+        *cell = fromLeft;
+      }
+      else {
+        removeHorizontalSeam(images[c], horizontalSeam.data(), energies[c]);
+        *cell = fromAbove;
+      }
+    }
+  }
+
+  copyImage(images[cols], image);
+  stats.energyRemoved = best.back();
+  stats.verticalSeams = cols;
+  stats.horizontalSeams = rows;
+  release();
+  return true;
+}
+
+RetargetStats retargetImage(Image* image, int targetWidth, int targetHeight, SeamOrder order, SeamMode mode, CarveContext* context) {
+  RetargetStats stats = { 0.0, 0, 0, 0 };
+  auto start = chrono::steady_clock::now();
+  targetWidth = max(1, min(targetWidth, image->width));
+  targetHeight = max(1, min(targetHeight, image->height));
+
+  if (order == ORDER_OPTIMAL) {
+    retargetOptimal(image, targetWidth, targetHeight, stats);
+  }
+  else if (context != nullptr) {
+    retargetGreedy(image, targetWidth, targetHeight, mode, *context, stats);
+  }
+  else {
+    CarveContext owned;
+    retargetGreedy(image, targetWidth, targetHeight, mode, owned, stats);
+  }
+
+  stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  return stats;
+}
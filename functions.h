@@ -1,38 +1,213 @@
-#ifndef FUNCTIONS_H
-#define FUNCTIONS_H
-
-#include <string>
-
-struct Pixel {
-  int r; // red
-  int g; // green
-  int b; // blue
-};
-
-// Implemented for you
-
-Pixel** createImage(int width, int height);
-void deleteImage(Pixel** image, int width);
-
-// Implement for part 1
-
-int* createSeam(int length);
-void deleteSeam(int* seam);
-bool loadImage(std::string filename, Pixel** image, int width, int height);
-bool outputImage(std::string filename, const Pixel*const* image, int width, int height);
-int energy(const Pixel*const* image, int x, int y, int width, int height);
-
-// Implement for part 2
-
-// uncomment for part 2
-
-
-int loadVerticalSeam(const Pixel*const* image, int start_col, int width, int height, int* seam);
-int loadHorizontalSeam(const Pixel*const* image, int start_row, int width, int height, int* seam);
-int* findMinVerticalSeam(const Pixel*const* image, int width, int height);
-int* findMinHorizontalSeam(const Pixel*const* image, int width, int height);
-void removeVerticalSeam(Pixel** image, int width, int height, int* verticalSeam);
-void removeHorizontalSeam(Pixel** image, int width, int height, int* horizontalSeam);
-
-
-#endif
\ No newline at end of file
+#ifndef FUNCTIONS_H
+#define FUNCTIONS_H
+
+#include <string>
+
+struct Pixel {
+  int r; // red
+  int g; // green
+  int b; // blue
+};
+
+// row-major image stored in one aligned allocation
+// pixel (col, row) lives at pixels[row * stride + col]
+// T is the pixel type: Pixel for the int API below, or one of the compact formats in pixelformat.h
+template <class T>
+struct BasicImage {
+  int width;     // # of columns currently in use
+  int height;    // # of rows currently in use
+  int stride;    // # of pixels from the start of one row to the start of the next
+  T* pixels;     // stride * height pixels, every row starts on a 64 byte boundary
+};
+
+typedef BasicImage<Pixel> Image;
+
+template <class T>
+inline T* imageRow(BasicImage<T>* image, int row) {
+  return image->pixels + static_cast<long>(row) * image->stride;
+}
+
+template <class T>
+inline const T* imageRow(const BasicImage<T>* image, int row) {
+  return image->pixels + static_cast<long>(row) * image->stride;
+}
+
+// energy of every pixel in an image, laid out like the image itself
+// removeVerticalSeam keeps it in sync so it only has to be computed in full once
+struct EnergyMap {
+  int width;   // # of columns currently in use
+  int height;  // # of rows currently in use
+  int stride;  // # of values from the start of one row to the start of the next
+  int* values; // values[row * stride + col] == energy(image, col, row)
+};
+
+inline int* energyMapRow(EnergyMap* energies, int row) {
+  return energies->values + static_cast<long>(row) * energies->stride;
+}
+
+inline const int* energyMapRow(const EnergyMap* energies, int row) {
+  return energies->values + static_cast<long>(row) * energies->stride;
+}
+
+// Implemented for you
+
+Image* createImage(int width, int height);
+void deleteImage(Image* image);
+void setVerbose(bool enabled); // createImage/deleteImage progress messages, on by default
+
+// Implement for part 1
+
+int* createSeam(int length);
+void deleteSeam(int* seam);
+// samples are rescaled from the file's maxval to 0-maxval (65535 keeps 16-bit P6 files exact)
+bool loadImage(std::string filename, Image* image, int maxval = 255);
+bool loadImageHeader(std::string filename, int& width, int& height); // size from the P3/P6 header
+// how outputImage encodes the file
+enum PpmFormat {
+  PPM_AUTO,   // binary for names ending in .pnm, ASCII otherwise
+  PPM_ASCII,  // P3
+  PPM_BINARY  // P6
+};
+
+// samples are clamped to 0-maxval; P6 files with maxval above 255 get two bytes per sample
+// the file is written under a temporary name and renamed into place, so a failed write
+// leaves no partial file behind
+bool outputImage(std::string filename, const Image* image, PpmFormat format = PPM_AUTO, int maxval = 255);
+int energy(const Image* image, int x, int y);
+
+// threads used for energy maps, seam search and seam removal (0 = one per core)
+// every thread count produces exactly the same seams
+void setThreadCount(int threads);
+// the same for carves run on the calling thread only, e.g. one worker of a batch, leaving
+// every other thread on the process-wide count (0 = back to it)
+void setThreadCountOnThisThread(int threads);
+int threadCount(); // what carves on the calling thread use
+
+// instruction set used by computeEnergyRow, picked from CPUID at startup
+enum EnergyBackend {
+  ENERGY_SCALAR,
+  ENERGY_SSE4,
+  ENERGY_AVX2
+};
+
+EnergyBackend energyBackend();
+bool setEnergyBackend(EnergyBackend backend); // false if this CPU can't run it
+void computeEnergyRow(const Image* image, int y, int* out); // out[x] == energy(image, x, y)
+EnergyMap* createEnergyMap(const Image* image);
+void deleteEnergyMap(EnergyMap* energies);
+
+// Implement for part 2
+
+// uncomment for part 2
+
+
+// how findMinVerticalSeam searches for the seam
+enum SeamMode {
+  SEAM_DP,     // cumulative-cost table, exact minimum seam in O(width * height)
+  SEAM_GREEDY, // greedy walk (loadVerticalSeam) from every start column, kept for comparison
+  SEAM_PYRAMID // exact search on a downsampled energy map, refined level by level inside a
+               // band around the upscaled seam; close to SEAM_DP, not guaranteed to match it
+};
+
+// SEAM_PYRAMID settings: number of half-size levels above full resolution (0 = plain DP) and
+// how many columns either side of the upscaled seam are searched at each finer level.
+// Levels stop early once the map would be narrower than a few bands. Defaults: 2 levels, band 8
+void setPyramid(int levels, int band);
+
+// the horizontal versions work on a transposed copy: loadHorizontalSeam returns -1 and
+// findMinHorizontalSeam nullptr, with an error printed, when there is no memory for it
+int loadVerticalSeam(const Image* image, int start_col, int* seam);
+int loadHorizontalSeam(const Image* image, int start_row, int* seam);
+int* findMinVerticalSeam(const Image* image, SeamMode mode = SEAM_DP, const EnergyMap* energies = nullptr);
+int* findMinHorizontalSeam(const Image* image, SeamMode mode = SEAM_DP, const EnergyMap* energies = nullptr);
+void removeVerticalSeam(Image* image, const int* verticalSeam, EnergyMap* energies = nullptr);
+void removeHorizontalSeam(Image* image, const int* horizontalSeam, EnergyMap* energies = nullptr);
+
+
+// batch removal: up to count seams that share no pixel are taken from one cost table
+// and removed in a single compaction sweep per row. The first seam is the exact
+// minimum; the others ignore the energy changes caused by the rest of the batch
+// and have to route around them, so bigger batches trade seam quality for speed.
+// returns the number of seams removed (at least 1 while width > 1)
+int removeVerticalSeams(Image* image, int count, EnergyMap* energies = nullptr);
+// batch size for a pass with `remaining` columns still to remove
+int adaptiveSeamsPerPass(int width, int remaining);
+// same as removeVerticalSeams, run on the transposed image; 0 if it can't be transposed
+int removeHorizontalSeams(Image* image, int count, EnergyMap* energies = nullptr);
+
+// cache-blocked transposes; destination must have been created at least
+// source->height wide and source->width tall
+void transposeImage(const Image* source, Image* destination);
+void transposeEnergyMap(const EnergyMap* source, EnergyMap* destination);
+// destination must have been created at least as big as source
+void copyImage(const Image* source, Image* destination);
+
+// remove seams until the image is targetWidth wide / targetHeight tall
+// seamsPerPass: 1 = one exact seam at a time, 0 = adaptiveSeamsPerPass, k = batches of k
+// horizontal carving transposes the image once, carves vertically and transposes back
+// mode picks the search for one-at-a-time passes, batches always use the DP
+// targets below 1 carve down to 1; returns the number of seams removed (0 for horizontal
+// batches if there is no memory for the transpose)
+int carveVerticalSeams(Image* image, int targetWidth, int seamsPerPass = 1, SeamMode mode = SEAM_DP);
+int carveHorizontalSeams(Image* image, int targetHeight, int seamsPerPass = 1, SeamMode mode = SEAM_DP);
+
+// working memory of a carve: the seam, energy map, cost table, pyramid levels and transposed
+// copies. They grow to the largest image carved with the context and are then reused, so
+// carving seams one at a time with a context allocates nothing once it has warmed up.
+// A horizontal carve works on a height x width transposed copy, so warming up takes one carve
+// of each direction: after a vertical carve alone, the first horizontal one still allocates.
+// Keep one per image being carved, or one per thread in batch mode; a context must not be
+// shared by two carves at once
+struct CarveContext;
+CarveContext* createCarveContext();
+void deleteCarveContext(CarveContext* context);
+
+// energies already computed for image, e.g. kept from an earlier carve of the same pixels: the
+// next carve with context of image itself (retargetImage's greedy order or carveVerticalSeams)
+// copies them instead of computing its first energy map. energies must outlive that carve. A
+// seed is used once; image = nullptr drops one no carve has used
+void seedEnergies(CarveContext* context, const Image* image, const EnergyMap* energies);
+
+// one exact (or pyramid) seam at a time, like seamsPerPass = 1, with the context's buffers
+int carveVerticalSeams(Image* image, int targetWidth, CarveContext* context, SeamMode mode = SEAM_DP);
+int carveHorizontalSeams(Image* image, int targetHeight, CarveContext* context, SeamMode mode = SEAM_DP);
+
+// the seam search on its own: cheapest vertical seam of energies written to seam, returns its
+// energy. SEAM_GREEDY searches with the DP. Scratch comes from context, or is temporary without one
+long long traceMinVerticalSeam(const EnergyMap* energies, int* seam, SeamMode mode = SEAM_DP, CarveContext* context = nullptr);
+// the DP's cost table outlives the search in context. After removing the seam it returned
+// (removeVerticalSeam has updated energies), this shifts the table along with the energies and
+// recomputes only the cells downstream of the changes: a cone widening by a column a row above
+// the seam, cut short wherever the costs come out unchanged. The next SEAM_DP search on the same
+// energies then only traces the seam, and finds exactly the one a full search would. Only call
+// it when that search follows; after anything else the next search builds the table from scratch
+void updateVerticalCost(const EnergyMap* energies, const int* removedSeam, CarveContext* context);
+
+// the DP restricted to the columns within band of centers[row] in every row, e.g. around the
+// seam another frame removed: the cheapest seam among those, with the full search's tie-breaks.
+// centers must be a seam of energies' size. About (2 * band + 1) / width of a full search
+long long traceBandedVerticalSeam(const EnergyMap* energies, const int* centers, int band, int* seam, CarveContext* context = nullptr);
+
+// order in which retargetImage mixes vertical and horizontal seams
+enum SeamOrder {
+  ORDER_GREEDY,  // each step removes whichever of the best vertical/horizontal seam is cheaper
+  ORDER_OPTIMAL  // transport-map DP over (rows removed, columns removed); keeps one image and
+                 // energy map per column removed and does two seam searches per table cell.
+                 // Out of memory it prints an error, removes no seams and leaves image as it was
+};
+
+struct RetargetStats {
+  double seconds;          // wall time of the whole retarget
+  long long energyRemoved; // total energy of every removed seam, measured when it was removed
+  int verticalSeams;
+  int horizontalSeams;
+};
+
+// remove seams one at a time until the image is targetWidth x targetHeight
+// mode is the seam search of the greedy order (SEAM_DP or SEAM_PYRAMID), the optimal order is always exact
+// the greedy order takes its buffers from context when one is given
+RetargetStats retargetImage(Image* image, int targetWidth, int targetHeight, SeamOrder order = ORDER_GREEDY, SeamMode mode = SEAM_DP,
+                            CarveContext* context = nullptr);
+
+
+#endif
@@ -0,0 +1,276 @@
+#include <cstdio>
+#include "instrument.h"
+
+std::string jsonString(const std::string& text) {
+  std::string quoted = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    }
+    else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+      quoted += escaped;
+    }
+    else {
+      quoted += c;
+    }
+  }
+  return quoted + "\"";
+}
+
+#ifdef SEAM_PROFILE
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <algorithm>
+#include <iomanip>
+
+using namespace std;
+
+static const char* const phaseNames[PHASE_COUNT] = { "load", "energy", "search", "remove", "transpose", "copy", "output" };
+static const char* const counterNames[COUNTER_COUNT] = { "energy_evaluations", "seams_removed", "bytes_read", "bytes_written" };
+
+static atomic<long long> phaseNanoseconds[PHASE_COUNT];
+static atomic<long long> phaseCalls[PHASE_COUNT];
+static atomic<long long> counters[COUNTER_COUNT];
+
+//live images and energy maps, so the release side knows how big each one was
+static mutex memoryLock;
+static unordered_map<const void*, long long> allocations;
+static long long currentBytes = 0;
+static long long peakBytes = 0;
+
+struct TraceEvent {
+  string name;
+  long long start;
+  long long duration;
+  int thread;
+};
+
+//a long carve produces a handful of events per seam, past this they are only counted
+static const size_t MAX_TRACE_EVENTS = 1 << 20;
+static mutex traceLock;
+static vector<TraceEvent> traceEvents;
+static long long droppedEvents = 0;
+
+static atomic<long long> runStart(chrono::steady_clock::now().time_since_epoch().count());
+static atomic<int> nextThread(0);
+static thread_local ProfileScope* innermost = nullptr;
+static thread_local int threadNumber = nextThread++;
+
+//nanoseconds since the last profileReset
+static long long now() {
+  return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count() - runStart;
+}
+
+ProfileScope::ProfileScope(ProfilePhase phase) : phase(phase), task(), start(now()), resumed(start), self(0), parent(innermost) {
+  if (parent != nullptr) {
+    parent->self += start - parent->resumed;
+  }
+  innermost = this;
+}
+
+ProfileScope::ProfileScope(const string& task) : phase(PHASE_COUNT), task(task), start(now()), resumed(start), self(0), parent(innermost) {
+  if (parent != nullptr) {
+    parent->self += start - parent->resumed;
+  }
+  innermost = this;
+}
+
+ProfileScope::~ProfileScope() {
+  long long end = now();
+  self += end - resumed;
+  if (phase < PHASE_COUNT) {
+    phaseNanoseconds[phase] += self;
+    phaseCalls[phase] += 1;
+  }
+  {
+    lock_guard<mutex> guard(traceLock);
+    if (traceEvents.size() < MAX_TRACE_EVENTS) {
+      traceEvents.push_back({ phase < PHASE_COUNT ? phaseNames[phase] : task, start, end - start, threadNumber });
+    }
+    else {
+      ++droppedEvents;
+    }
+  }
+  innermost = parent;
+  if (parent != nullptr) {
+    parent->resumed = end;
+  }
+}
+
+void profileCount(ProfileCounter counter, long long amount) {
+  counters[counter].fetch_add(amount, memory_order_relaxed);
+}
+
+void profileAllocate(const void* pointer, long long bytes) {
+  lock_guard<mutex> guard(memoryLock);
+  allocations[pointer] = bytes;
+  currentBytes += bytes;
+  peakBytes = max(peakBytes, currentBytes);
+}
+
+void profileRelease(const void* pointer) {
+  lock_guard<mutex> guard(memoryLock);
+  auto found = allocations.find(pointer);
+  if (found != allocations.end()) {
+    currentBytes -= found->second;
+    allocations.erase(found);
+  }
+}
+
+void profileReset() {
+  for (int i = 0; i < PHASE_COUNT; ++i) {
+    phaseNanoseconds[i] = 0;
+    phaseCalls[i] = 0;
+  }
+  for (int i = 0; i < COUNTER_COUNT; ++i) {
+    counters[i] = 0;
+  }
+  {
+    //whatever is still allocated carries over into the new run
+    lock_guard<mutex> guard(memoryLock);
+    peakBytes = currentBytes;
+  }
+  {
+    lock_guard<mutex> guard(traceLock);
+    traceEvents.clear();
+    droppedEvents = 0;
+  }
+  runStart = chrono::steady_clock::now().time_since_epoch().count();
+}
+
+static long long peakImageBytes() {
+  lock_guard<mutex> guard(memoryLock);
+  return peakBytes;
+}
+
+void profilePrintSummary(string label) {
+  cout << "Profile of " << label << ": " << now() / 1e9 << " s" << endl;
+  for (int i = 0; i < PHASE_COUNT; ++i) {
+    cout << "  " << phaseNames[i] << ": " << phaseNanoseconds[i] / 1e9 << " s in " << phaseCalls[i] << " calls" << endl;
+  }
+  for (int i = 0; i < COUNTER_COUNT; ++i) {
+    cout << "  " << counterNames[i] << ": " << counters[i] << endl;
+  }
+  cout << "  peak_image_bytes: " << peakImageBytes() << endl;
+}
+
+bool profileWriteJson(string path, string label) {
+  ofstream out(path);
+  if (!out.is_open()) {
+    cout << "Error: failed to open profile file - " << path << endl;
+    return false;
+  }
+  out << fixed << setprecision(6);
+  out << "{\n  \"label\": " << jsonString(label) << ",\n  \"seconds\": " << now() / 1e9 << ",\n  \"phases\": {\n";
+  for (int i = 0; i < PHASE_COUNT; ++i) {
+    out << "    \"" << phaseNames[i] << "\": {\"seconds\": " << phaseNanoseconds[i] / 1e9 << ", \"calls\": " << phaseCalls[i]
+        << "}" << (i + 1 < PHASE_COUNT ? "," : "") << "\n";
+  }
+  out << "  },\n  \"counters\": {\n";
+  for (int i = 0; i < COUNTER_COUNT; ++i) {
+    out << "    \"" << counterNames[i] << "\": " << counters[i] << ",\n";
+  }
+  out << "    \"peak_image_bytes\": " << peakImageBytes() << "\n  }\n}\n";
+  return static_cast<bool>(out);
+}
+
+bool profileWriteTrace(string path) {
+  ofstream out(path);
+  if (!out.is_open()) {
+    cout << "Error: failed to open trace file - " << path << endl;
+    return false;
+  }
+  lock_guard<mutex> guard(traceLock);
+  out << fixed << setprecision(3);
+  out << "{\"displayTimeUnit\": \"ms\", \"droppedEvents\": " << droppedEvents << ", \"traceEvents\": [\n";
+  for (size_t i = 0; i < traceEvents.size(); ++i) {
+    const TraceEvent& event = traceEvents[i];
+    //trace timestamps are in microseconds
+    out << "{\"name\": " << jsonString(event.name) << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.thread
+        << ", \"ts\": " << event.start / 1e3 << ", \"dur\": " << event.duration / 1e3 << "}"
+        << (i + 1 < traceEvents.size() ? "," : "") << "\n";
+  }
+  out << "]}\n";
+  return static_cast<bool>(out);
+}
+
+#endif
+
+#ifdef SEAM_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<long long> heapAllocationCount(0);
+
+//every replaced operator new ends up here; alignment 0 means the default
+static void* countedAllocate(std::size_t size, std::size_t alignment) {
+  ++heapAllocationCount;
+  if (size == 0) {
+    size = 1;
+  }
+  if (alignment <= alignof(std::max_align_t)) {
+    return std::malloc(size);
+  }
+  void* pointer = nullptr;
+  return posix_memalign(&pointer, alignment, size) == 0 ? pointer : nullptr;
+}
+
+static void* countedAllocateOrThrow(std::size_t size, std::size_t alignment) {
+  void* pointer = countedAllocate(size, alignment);
+  if (pointer == nullptr) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void* operator new(std::size_t size) { return countedAllocateOrThrow(size, 0); }
+void* operator new[](std::size_t size) { return countedAllocateOrThrow(size, 0); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return countedAllocateOrThrow(size, static_cast<std::size_t>(alignment)); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return countedAllocateOrThrow(size, static_cast<std::size_t>(alignment)); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return countedAllocate(size, 0); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return countedAllocate(size, 0); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return countedAllocate(size, static_cast<std::size_t>(alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return countedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+//malloc and posix_memalign memory both go back through free
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { std::free(pointer); }
+
+long long heapAllocations() {
+  return heapAllocationCount;
+}
+
+#else
+
+long long heapAllocations() {
+  return -1;
+}
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <string>
+
+// per-phase timers and counters, compiled in with -DSEAM_PROFILE
+// without it every PROFILE_* macro expands to nothing and the report functions do nothing
+
+// where the time of a run goes; a phase nested inside another only counts towards itself
+// phase times add up over the threads that ran them, so a batch can report more than its wall time
+enum ProfilePhase {
+  PHASE_LOAD,      // loadImage: mapping and parsing
+  PHASE_ENERGY,    // full energy maps and incremental energy updates
+  PHASE_SEARCH,    // cumulative-cost tables and seam tracing
+  PHASE_REMOVE,    // seam compaction
+  PHASE_TRANSPOSE, // transposes for horizontal seams
+  PHASE_COPY,      // copyImage
+  PHASE_OUTPUT,    // outputImage: formatting and writing
+  PHASE_COUNT
+};
+
+enum ProfileCounter {
+  COUNTER_ENERGY_EVALUATIONS,
+  COUNTER_SEAMS_REMOVED,
+  COUNTER_BYTES_READ,
+  COUNTER_BYTES_WRITTEN,
+  COUNTER_COUNT
+};
+
+#ifdef SEAM_PROFILE
+
+// times the enclosing block; also recorded as a trace event
+class ProfileScope {
+ public:
+  explicit ProfileScope(ProfilePhase phase);
+  // trace-only span, e.g. one image of a batch, not counted in any phase
+  explicit ProfileScope(const std::string& task);
+  ~ProfileScope();
+  ProfileScope(const ProfileScope&) = delete;
+  ProfileScope& operator=(const ProfileScope&) = delete;
+
+ private:
+  int phase;           // PHASE_COUNT for tasks
+  std::string task;
+  long long start;     // ns since profileReset
+  long long resumed;   // when a nested scope last handed time back to this one
+  long long self;      // time spent here and not in a nested scope
+  ProfileScope* parent;
+};
+
+void profileCount(ProfileCounter counter, long long amount);
+void profileAllocate(const void* pointer, long long bytes); // image or energy map allocated
+void profileRelease(const void* pointer);
+
+#define PROFILE_JOIN2(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN2(a, b)
+#define PROFILE_PHASE(phase) ProfileScope PROFILE_JOIN(profileScope, __LINE__)(phase)
+#define PROFILE_TASK(name) ProfileScope PROFILE_JOIN(profileScope, __LINE__)(name)
+#define PROFILE_COUNT(counter, amount) profileCount(counter, amount)
+#define PROFILE_ALLOCATE(pointer, bytes) profileAllocate(pointer, bytes)
+#define PROFILE_RELEASE(pointer) profileRelease(pointer)
+
+inline bool profileEnabled() { return true; }
+// start a new run: zero every timer and counter and drop the trace events
+void profileReset();
+// one line per phase and counter since the last reset
+void profilePrintSummary(std::string label);
+// the same numbers as a JSON object
+bool profileWriteJson(std::string path, std::string label);
+// every scope as a Chrome trace event (chrome://tracing, Perfetto)
+bool profileWriteTrace(std::string path);
+
+#else
+
+#define PROFILE_PHASE(phase) ((void)0)
+#define PROFILE_TASK(name) ((void)0)
+#define PROFILE_COUNT(counter, amount) ((void)0)
+#define PROFILE_ALLOCATE(pointer, bytes) ((void)0)
+#define PROFILE_RELEASE(pointer) ((void)0)
+
+inline bool profileEnabled() { return false; }
+inline void profileReset() {}
+inline void profilePrintSummary(std::string) {}
+inline bool profileWriteJson(std::string, std::string) { return false; }
+inline bool profileWriteTrace(std::string) { return false; }
+
+#endif
+
+// text as a quoted JSON string: quotes and backslashes escaped, control characters as \u00XX.
+// Used for every string the profile writers and the benchmark put into their JSON
+std::string jsonString(const std::string& text);
+
+// heap allocations made through the global operator new since the program started, for
+// checking that steady-state carving allocates nothing. Counted only in builds with
+// -DSEAM_COUNT_ALLOCATIONS, which replaces operator new and delete program-wide; -1 otherwise
+long long heapAllocations();
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef INTERNAL_H
+#define INTERNAL_H
+
+#include <algorithm>
+#include <cstring>
+#include "functions.h"
+#include "instrument.h"
+
+// helpers shared by the .cpp files of the library, not part of the public API
+
+// non-owning reference to a callable, for handing lambdas to the worker pool.
+// A std::function copies any lambda with more than a couple of captures to the heap,
+// which would put an allocation in every parallel section of every seam
+template <class Signature> class Callback;
+
+template <class... Args>
+class Callback<void(Args...)> {
+ public:
+  // function must outlive the Callback, which holds for a lambda passed straight to a call
+  template <class Function>
+  Callback(const Function& function)
+      : target(&function), invoke([](const void* f, Args... args) { (*static_cast<const Function*>(f))(args...); }) {}
+
+  void operator()(Args... args) const { invoke(target, args...); }
+
+ private:
+  const void* target;
+  void (*invoke)(const void*, Args...);
+};
+
+// split [0, count) into one contiguous block per thread and run work(first, last) on each
+// blocks never get smaller than minimum, so small inputs stay on the calling thread
+void parallelBlocks(int count, int minimum, Callback<void(int, int)> work);
+// rows per block so that each thread gets at least a few tens of thousands of pixels
+int rowsPerThread(int width);
+// energy map with room for width x height values, contents undefined
+EnergyMap* allocateEnergyMap(int width, int height, int stride);
+
+//dual-gradient energy of pixel (x, y) for any pixel type: the squared difference of its left
+//and right neighbours plus that of the ones above and below, wrapping around at the borders,
+//and no gradient along a side under 3 pixels. gradient(a, b) is the squared colour difference
+template <class T, class Gradient>
+int dualGradientEnergy(const BasicImage<T>* image, int x, int y, Gradient gradient) {
+  int width = image->width;
+  int height = image->height;
+  const T* row = imageRow(image, y);
+  int total = 0;
+  if (width >= 3) {
+    total += gradient(row[(x - 1 + width) % width], row[(x + 1) % width]);
+  }
+  if (height >= 3) {
+    total += gradient(imageRow(image, (y - 1 + height) % height)[x], imageRow(image, (y + 1) % height)[x]);
+  }
+  PROFILE_COUNT(COUNTER_ENERGY_EVALUATIONS, 1);
+  return total;
+}
+
+//energies of one row y into out: interior(row, above, below, out) fills columns [1, width - 1)
+//from the row and the rows it is compared against (the row itself when height < 3), and the
+//two border columns, which wrap around, go through energy(x, y)
+template <class T, class Interior, class Energy>
+void dualGradientRow(const BasicImage<T>* image, int y, int* out, const Interior& interior, const Energy& energy) {
+  int width = image->width;
+  int height = image->height;
+  //too narrow for an interior, energy() already handles every case
+  if (width < 3) {
+    for (int col = 0; col < width; ++col) {
+      out[col] = energy(col, y);
+    }
+    return;
+  }
+
+  //with fewer than 3 rows the vertical gradient is zero: compare the row with itself
+  const T* row = imageRow(image, y);
+  const T* above = row;
+  const T* below = row;
+  if (height >= 3) {
+    above = imageRow(image, (y - 1 + height) % height);
+    below = imageRow(image, (y + 1) % height);
+  }
+  interior(row, above, below, out);
+  PROFILE_COUNT(COUNTER_ENERGY_EVALUATIONS, width - 2);
+
+  //wrap-around columns
+  out[0] = energy(0, y);
+  out[width - 1] = energy(width - 1, y);
+}
+
+//after a vertical seam is gone only pixels whose neighbours changed need new energies:
+//- left/right of the seam in its own row (wrapping around at the borders)
+//- pixels whose pixel above/below shifted by a different amount than they did,
+//  i.e. the columns between this row's seam and the neighbouring row's seam
+//width and height are the image's after the removal. refresh(row, first, last) recomputes
+//the energies of columns [first, last) of row; rows are split across threads
+template <class Refresh>
+void refreshAfterVerticalSeam(int width, int height, const int* verticalSeam, const Refresh& refresh) {
+  //going from 3 columns to 2 zeroes every horizontal gradient
+  if (width < 3) {
+    for (int row = 0; row < height; ++row) {
+      refresh(row, 0, width);
+    }
+    return;
+  }
+
+  parallelBlocks(height, rowsPerThread(width), [&](int firstRow, int lastRow) {
+    for (int row = firstRow; row < lastRow; ++row) {
+      int col = verticalSeam[row];
+      int left = (col - 1 + width) % width;
+      int right = col % width;
+      refresh(row, left, left + 1);
+      refresh(row, right, right + 1);
+
+      if (height < 3) {
+        continue;
+      }
+      //energies wrap row 0 onto the last row, so those two seams may be far apart
+      int neighbours[2] = { (row - 1 + height) % height, (row + 1) % height };
+      for (int neighbour : neighbours) {
+        int first = std::min(col, verticalSeam[neighbour]);
+        int last = std::min(std::max(col, verticalSeam[neighbour]), width);
+        refresh(row, first, last);
+      }
+    }
+  });
+}
+
+//mirror of refreshAfterVerticalSeam with rows and columns swapped: refresh(col, first, last)
+//recomputes the energies of rows [first, last) of column col; columns are split across threads
+template <class Refresh>
+void refreshAfterHorizontalSeam(int width, int height, const int* horizontalSeam, const Refresh& refresh) {
+  //going from 3 rows to 2 zeroes every vertical gradient
+  if (height < 3) {
+    for (int col = 0; col < width; ++col) {
+      refresh(col, 0, height);
+    }
+    return;
+  }
+
+  parallelBlocks(width, std::max(1, rowsPerThread(height)), [&](int firstCol, int lastCol) {
+    for (int col = firstCol; col < lastCol; ++col) {
+      int row = horizontalSeam[col];
+      int above = (row - 1 + height) % height;
+      int below = row % height;
+      refresh(col, above, above + 1);
+      refresh(col, below, below + 1);
+
+      if (width < 3) {
+        continue;
+      }
+      int neighbours[2] = { (col - 1 + width) % width, (col + 1) % width };
+      for (int neighbour : neighbours) {
+        int first = std::min(row, horizontalSeam[neighbour]);
+        int last = std::min(std::max(row, horizontalSeam[neighbour]), height);
+        refresh(col, first, last);
+      }
+    }
+  });
+}
+
+//every row of source without its pixel at verticalSeam[row], written to destination (which
+//may be source), and the rows of energies, if any, closed up the same way. Sizes are left to
+//the caller
+template <class T>
+void closeVerticalSeam(const BasicImage<T>* source, const int* verticalSeam, BasicImage<T>* destination, EnergyMap* energies) {
+  int width = source->width;
+  //rows don't depend on each other, so blocks of rows go to different threads
+  parallelBlocks(source->height, rowsPerThread(width), [&](int first, int last) {
+    for (int i = first; i < last; ++i) {
+      const T* in = imageRow(source, i);
+      T* out = imageRow(destination, i);
+      int col = verticalSeam[i];
+      if (out != in) {
+        std::memcpy(static_cast<void*>(out), in, sizeof(T) * col);
+      }
+      std::memmove(static_cast<void*>(out + col), in + col + 1, sizeof(T) * (width - col - 1));
+      if (energies != nullptr) {
+        int* energyLine = energyMapRow(energies, i);
+        std::memmove(energyLine + col, energyLine + col + 1, sizeof(int) * (width - col - 1));
+      }
+    }
+  });
+}
+
+//side of the square tiles used by the transposes, 32 * 32 Pixels is 12KB and fits in L1
+static const int TRANSPOSE_TILE = 32;
+
+//cache-blocked transpose: walk the source in tiles so both the reads and the
+//writes stay within a few cache lines per row, instead of striding a whole
+//column of the destination for every source row
+template <class T>
+void transposeTiles(const T* source, long sourceStride, int width, int height, T* destination, long destinationStride) {
+  PROFILE_PHASE(PHASE_TRANSPOSE);
+  int tileRows = (height + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+  parallelBlocks(tileRows, std::max(1, rowsPerThread(width) / TRANSPOSE_TILE), [&](int firstTile, int lastTile) {
+    for (int tile = firstTile; tile < lastTile; ++tile) {
+      int rowStart = tile * TRANSPOSE_TILE;
+      int rowEnd = std::min(height, rowStart + TRANSPOSE_TILE);
+      for (int colStart = 0; colStart < width; colStart += TRANSPOSE_TILE) {
+        int colEnd = std::min(width, colStart + TRANSPOSE_TILE);
+        for (int row = rowStart; row < rowEnd; ++row) {
+          const T* in = source + row * sourceStride;
+          for (int col = colStart; col < colEnd; ++col) {
+            destination[col * destinationStride + row] = in[col];
+          }
+        }
+      }
+    }
+  });
+}
+
+#endif
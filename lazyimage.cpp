@@ -0,0 +1,188 @@
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <vector>
+#include "lazyimage.h"
+#include "internal.h"
+
+using namespace std;
+
+//every live row back to 0, 1, 2, ... width - 1
+static void resetColumns(LazyImage* lazy) {
+  lazy->width = lazy->image->width;
+  parallelBlocks(lazy->image->height, rowsPerThread(lazy->width), [&](int first, int last) {
+    for (int row = first; row < last; ++row) {
+      int* columns = liveColumns(lazy, row);
+      for (int k = 0; k < lazy->width; ++k) {
+        columns[k] = k;
+      }
+    }
+  });
+}
+
+LazyImage* createLazyImage(Image* image) {
+  size_t entries = static_cast<size_t>(image->stride) * image->height;
+  int* columns = new (std::nothrow) int[entries];
+  if (columns == nullptr) {
+    return nullptr;
+  }
+  LazyImage* lazy = new (std::nothrow) LazyImage{ image, image->width, columns };
+  if (lazy == nullptr) {
+    delete[] columns;
+    return nullptr;
+  }
+  resetColumns(lazy);
+  return lazy;
+}
+
+void deleteLazyImage(LazyImage* lazy) {
+  if (lazy == nullptr) {
+    return;
+  }
+  delete[] lazy->columns;
+  delete lazy;
+}
+
+static inline int square(int value) {
+  return value * value;
+}
+
+int energy(const LazyImage* lazy, int k, int y) {
+  int width = lazy->width;
+  int height = lazy->image->height;
+  int total = 0;
+  if (width >= 3) {
+    const Pixel* row = imageRow(lazy->image, y);
+    const int* columns = liveColumns(lazy, y);
+    const Pixel& left = row[columns[(k - 1 + width) % width]];
+    const Pixel& right = row[columns[(k + 1) % width]];
+    total += square(right.r - left.r) + square(right.g - left.g) + square(right.b - left.b);
+  }
+  if (height >= 3) {
+    int up = (y - 1 + height) % height;
+    int down = (y + 1) % height;
+    const Pixel& above = imageRow(lazy->image, up)[liveColumns(lazy, up)[k]];
+    const Pixel& below = imageRow(lazy->image, down)[liveColumns(lazy, down)[k]];
+    total += square(below.r - above.r) + square(below.g - above.g) + square(below.b - above.b);
+  }
+  PROFILE_COUNT(COUNTER_ENERGY_EVALUATIONS, 1);
+  return total;
+}
+
+EnergyMap* createEnergyMap(const LazyImage* lazy) {
+  //the full map is only built on a dense view, where the SIMD rows apply
+  if (lazy->width == lazy->image->width) {
+    return createEnergyMap(lazy->image);
+  }
+  EnergyMap* energies = allocateEnergyMap(lazy->width, lazy->image->height, lazy->image->stride);
+  if (energies == nullptr) {
+    return nullptr;
+  }
+  PROFILE_PHASE(PHASE_ENERGY);
+  parallelBlocks(lazy->image->height, rowsPerThread(lazy->width), [&](int first, int last) {
+    for (int row = first; row < last; ++row) {
+      int* line = energyMapRow(energies, row);
+      for (int k = 0; k < lazy->width; ++k) {
+        line[k] = energy(lazy, k, row);
+      }
+    }
+  });
+  return energies;
+}
+
+//the pixels refreshAfterVerticalSeam picks, read through the live columns
+static void updateEnergiesAfterVerticalSeam(const LazyImage* lazy, EnergyMap* energies, const int* verticalSeam) {
+  PROFILE_PHASE(PHASE_ENERGY);
+  energies->width = lazy->width;
+  refreshAfterVerticalSeam(lazy->width, lazy->image->height, verticalSeam, [&](int row, int first, int last) {
+    int* line = energyMapRow(energies, row);
+    for (int k = first; k < last; ++k) {
+      line[k] = energy(lazy, k, row);
+    }
+  });
+}
+
+void removeVerticalSeam(LazyImage* lazy, const int* verticalSeam, EnergyMap* energies) {
+  PROFILE_PHASE(PHASE_REMOVE);
+  PROFILE_COUNT(COUNTER_SEAMS_REMOVED, 1);
+  int width = lazy->width;
+  parallelBlocks(lazy->image->height, rowsPerThread(width), [&](int first, int last) {
+    for (int row = first; row < last; ++row) {
+      int col = verticalSeam[row];
+      int* columns = liveColumns(lazy, row);
+      memmove(columns + col, columns + col + 1, sizeof(int) * (width - col - 1));
+      int* energyLine = energyMapRow(energies, row);
+      memmove(energyLine + col, energyLine + col + 1, sizeof(int) * (width - col - 1));
+    }
+  });
+  lazy->width = width - 1;
+  updateEnergiesAfterVerticalSeam(lazy, energies, verticalSeam);
+}
+
+int carveVerticalSeams(LazyImage* lazy, int targetWidth, CarveContext* context, SeamMode mode) {
+  if (lazy->width <= targetWidth) {
+    return 0;
+  }
+  EnergyMap* energies = createEnergyMap(lazy);
+  if (energies == nullptr) {
+    return 0;
+  }
+  vector<int> seam(lazy->image->height);
+  int removed = 0;
+  while (lazy->width > targetWidth) {
+    traceMinVerticalSeam(energies, seam.data(), mode, context);
+    removeVerticalSeam(lazy, seam.data(), energies);
+    if (lazy->width > targetWidth) {
+      updateVerticalCost(energies, seam.data(), context);
+    }
+    ++removed;
+  }
+  deleteEnergyMap(energies);
+  return removed;
+}
+
+void compactImage(LazyImage* lazy) {
+  PROFILE_PHASE(PHASE_REMOVE);
+  //live columns only ever increase along a row and k <= columns[k], so gathering from left
+  //to right never reads a pixel that has already been overwritten
+  parallelBlocks(lazy->image->height, rowsPerThread(lazy->image->width), [&](int first, int last) {
+    for (int row = first; row < last; ++row) {
+      Pixel* line = imageRow(lazy->image, row);
+      const int* columns = liveColumns(lazy, row);
+      for (int k = 0; k < lazy->width; ++k) {
+        line[k] = line[columns[k]];
+      }
+    }
+  });
+  lazy->image->width = lazy->width;
+  resetColumns(lazy);
+}
+
+//vertical seams on image itself, horizontal seams on its transpose
+int carveLazily(Image* image, int targetWidth, int targetHeight, CarveContext* context, SeamMode mode) {
+  int removed = 0;
+  if (image->width > targetWidth) {
+    LazyImage* lazy = createLazyImage(image);
+    if (lazy == nullptr) {
+      return 0;
+    }
+    removed += carveVerticalSeams(lazy, targetWidth, context, mode);
+    compactImage(lazy);
+    deleteLazyImage(lazy);
+  }
+  if (image->height > targetHeight) {
+    Image* transposed = createImage(image->height, image->width);
+    LazyImage* lazy = transposed != nullptr ? createLazyImage(transposed) : nullptr;
+    if (lazy == nullptr) {
+      deleteImage(transposed);
+      return removed;
+    }
+    transposeImage(image, transposed);
+    removed += carveVerticalSeams(lazy, targetHeight, context, mode);
+    compactImage(lazy);
+    transposeImage(transposed, image);
+    deleteLazyImage(lazy);
+    deleteImage(transposed);
+  }
+  return removed;
+}
@@ -0,0 +1,44 @@
+#ifndef LAZYIMAGE_H
+#define LAZYIMAGE_H
+
+#include "functions.h"
+
+// an image whose vertical seams are removed lazily. The pixels stay where they were loaded;
+// every row keeps the original columns that are still alive, in order, and removing a seam
+// shifts those 4 byte indices (and the energies) instead of 12 byte Pixels. Energy updates
+// read the pixels through the indices, and the pixels are moved once, by compactImage.
+// The seams removed are exactly the ones carveVerticalSeams would remove.
+struct LazyImage {
+  Image* image;  // the pixels, at their original positions until compactImage
+  int width;     // live columns in every row
+  int* columns;  // columns[row * image->stride + k] = original column of the row's k-th live pixel
+};
+
+inline int* liveColumns(LazyImage* lazy, int row) {
+  return lazy->columns + static_cast<long>(row) * lazy->image->stride;
+}
+
+inline const int* liveColumns(const LazyImage* lazy, int row) {
+  return lazy->columns + static_cast<long>(row) * lazy->image->stride;
+}
+
+// wraps image (not taken over); image must not be used on its own again until compactImage
+LazyImage* createLazyImage(Image* image);
+void deleteLazyImage(LazyImage* lazy);
+
+// energy of the k-th live pixel of row y, what energy() gives on the compacted image
+int energy(const LazyImage* lazy, int k, int y);
+EnergyMap* createEnergyMap(const LazyImage* lazy);
+void removeVerticalSeam(LazyImage* lazy, const int* verticalSeam, EnergyMap* energies);
+// one exact (or pyramid) seam at a time, returns the number removed
+int carveVerticalSeams(LazyImage* lazy, int targetWidth, CarveContext* context, SeamMode mode = SEAM_DP);
+
+// move the live pixels into place: the image is lazy->width wide and dense again, and the
+// lazy view starts over from it
+void compactImage(LazyImage* lazy);
+
+// carveVerticalSeams then carveHorizontalSeams through lazy removal, one compaction per
+// direction (horizontal seams are carved on a transposed copy)
+int carveLazily(Image* image, int targetWidth, int targetHeight, CarveContext* context, SeamMode mode = SEAM_DP);
+
+#endif
@@ -0,0 +1,315 @@
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <vector>
+#include "pixelformat.h"
+#include "internal.h"
+
+using namespace std;
+
+template <class T>
+BasicImage<T>* createBasicImage(int width, int height) {
+  if (width <= 0 || height <= 0) {
+    return nullptr;
+  }
+
+  //rows start on 64 byte boundaries like createImage's; a stride of 64 pixels covers every format
+  int stride = (width + 63) / 64 * 64;
+  size_t bytes = sizeof(T) * static_cast<size_t>(stride) * static_cast<size_t>(height);
+  T* pixels = static_cast<T*>(::operator new(bytes, std::align_val_t(64), std::nothrow));
+  if (pixels == nullptr) {
+    return nullptr;
+  }
+
+  BasicImage<T>* image = new (std::nothrow) BasicImage<T>{ width, height, stride, pixels };
+  if (image == nullptr) {
+    ::operator delete(pixels, std::align_val_t(64));
+    return nullptr;
+  }
+  PROFILE_ALLOCATE(pixels, static_cast<long long>(bytes));
+  memset(static_cast<void*>(pixels), 0, bytes);
+  return image;
+}
+
+template <class T>
+void deleteBasicImage(BasicImage<T>* image) {
+  if (image == nullptr) {
+    return;
+  }
+  PROFILE_RELEASE(image->pixels);
+  ::operator delete(image->pixels, std::align_val_t(64));
+  delete image;
+}
+
+template <class T>
+BasicImage<T>* convertImage(const Image* image) {
+  BasicImage<T>* converted = createBasicImage<T>(image->width, image->height);
+  if (converted == nullptr) {
+    return nullptr;
+  }
+  parallelBlocks(image->height, rowsPerThread(image->width), [&](int first, int last) {
+    for (int row = first; row < last; ++row) {
+      const Pixel* in = imageRow(image, row);
+      T* out = imageRow(converted, row);
+      for (int col = 0; col < image->width; ++col) {
+        out[col] = PixelFormat<T>::fromPixel(in[col]);
+      }
+    }
+  });
+  return converted;
+}
+
+template <class T>
+void convertImage(const BasicImage<T>* source, Image* destination) {
+  destination->width = source->width;
+  destination->height = source->height;
+  parallelBlocks(source->height, rowsPerThread(source->width), [&](int first, int last) {
+    for (int row = first; row < last; ++row) {
+      const T* in = imageRow(source, row);
+      Pixel* out = imageRow(destination, row);
+      for (int col = 0; col < source->width; ++col) {
+        out[col] = PixelFormat<T>::toPixel(in[col]);
+      }
+    }
+  });
+}
+
+//the dual-gradient energy of energy(const Image*), on this format's gradient
+template <class T>
+int energy(const BasicImage<T>* image, int x, int y) {
+  return dualGradientEnergy(image, x, y, PixelFormat<T>::gradient);
+}
+
+template <class T>
+void computeEnergyRow(const BasicImage<T>* image, int y, int* out) {
+  int width = image->width;
+  auto interior = [&](const T* row, const T* above, const T* below, int* line) {
+    for (int col = 1; col < width - 1; ++col) {
+      line[col] = PixelFormat<T>::gradient(row[col - 1], row[col + 1]) + PixelFormat<T>::gradient(above[col], below[col]);
+    }
+  };
+  dualGradientRow(image, y, out, interior, [&](int x, int row) { return energy(image, x, row); });
+}
+
+template <class T>
+EnergyMap* createEnergyMap(const BasicImage<T>* image) {
+  EnergyMap* energies = allocateEnergyMap(image->width, image->height, image->stride);
+  if (energies == nullptr) {
+    return nullptr;
+  }
+  PROFILE_PHASE(PHASE_ENERGY);
+  parallelBlocks(image->height, rowsPerThread(image->width), [&](int first, int last) {
+    for (int row = first; row < last; ++row) {
+      computeEnergyRow(image, row, energyMapRow(energies, row));
+    }
+  });
+  return energies;
+}
+
+template <class T>
+void transposeImage(const BasicImage<T>* source, BasicImage<T>* destination) {
+  transposeTiles(source->pixels, source->stride, source->width, source->height, destination->pixels, destination->stride);
+  destination->width = source->height;
+  destination->height = source->width;
+}
+
+template <class T>
+static void updateEnergiesAfterVerticalSeam(const BasicImage<T>* image, EnergyMap* energies, const int* verticalSeam) {
+  PROFILE_PHASE(PHASE_ENERGY);
+  energies->width = image->width;
+  refreshAfterVerticalSeam(image->width, image->height, verticalSeam, [&](int row, int first, int last) {
+    int* line = energyMapRow(energies, row);
+    for (int col = first; col < last; ++col) {
+      line[col] = energy(image, col, row);
+    }
+  });
+}
+
+template <class T>
+void removeVerticalSeam(const BasicImage<T>* source, const int* verticalSeam, BasicImage<T>* destination, EnergyMap* energies) {
+  PROFILE_PHASE(PHASE_REMOVE);
+  PROFILE_COUNT(COUNTER_SEAMS_REMOVED, 1);
+  int width = source->width;
+  closeVerticalSeam(source, verticalSeam, destination, energies);
+
+  destination->width = width - 1;
+  destination->height = source->height;
+
+  if (energies != nullptr) {
+    updateEnergiesAfterVerticalSeam(destination, energies, verticalSeam);
+  }
+}
+
+template <class T>
+void removeVerticalSeam(BasicImage<T>* image, const int* verticalSeam, EnergyMap* energies) {
+  removeVerticalSeam(image, verticalSeam, image, energies);
+}
+
+//the pixels refreshAfterHorizontalSeam picks, into energies that are transposed
+template <class T>
+static void updateEnergiesAfterHorizontalSeam(const BasicImage<T>* image, EnergyMap* transposedEnergies, const int* horizontalSeam) {
+  PROFILE_PHASE(PHASE_ENERGY);
+  transposedEnergies->width = image->height;
+  refreshAfterHorizontalSeam(image->width, image->height, horizontalSeam, [&](int col, int first, int last) {
+    int* line = energyMapRow(transposedEnergies, col);
+    for (int row = first; row < last; ++row) {
+      line[row] = energy(image, col, row);
+    }
+  });
+}
+
+template <class T>
+void removeHorizontalSeam(const BasicImage<T>* source, const int* horizontalSeam, BasicImage<T>* destination, EnergyMap* transposedEnergies) {
+  PROFILE_PHASE(PHASE_REMOVE);
+  PROFILE_COUNT(COUNTER_SEAMS_REMOVED, 1);
+  int width = source->width;
+  int height = source->height;
+  //columns are independent, so threads split the columns and each walks its block down the rows
+  parallelBlocks(width, rowsPerThread(height), [&](int first, int last) {
+    for (int row = 0; row < height - 1; ++row) {
+      const T* here = imageRow(source, row);
+      const T* next = imageRow(source, row + 1);
+      T* out = imageRow(destination, row);
+      for (int col = first; col < last; ++col) {
+        out[col] = horizontalSeam[col] <= row ? next[col] : here[col];
+      }
+    }
+    if (transposedEnergies != nullptr) {
+      for (int col = first; col < last; ++col) {
+        int* energyLine = energyMapRow(transposedEnergies, col);
+        int row = horizontalSeam[col];
+        memmove(energyLine + row, energyLine + row + 1, sizeof(int) * (height - row - 1));
+      }
+    }
+  });
+
+  destination->width = width;
+  destination->height = height - 1;
+
+  if (transposedEnergies != nullptr) {
+    updateEnergiesAfterHorizontalSeam(destination, transposedEnergies, horizontalSeam);
+  }
+}
+
+template <class T>
+int carveVerticalSeams(BasicImage<T>* image, int targetWidth, SeamMode mode) {
+  targetWidth = max(1, targetWidth);
+  if (image->width <= targetWidth) {
+    return 0;
+  }
+  EnergyMap* energies = createEnergyMap(image);
+  CarveContext* context = createCarveContext();
+  if (energies == nullptr || context == nullptr) {
+    deleteEnergyMap(energies);
+    deleteCarveContext(context);
+    return 0;
+  }
+  vector<int> seam(image->height);
+  int removed = 0;
+  while (image->width > targetWidth) {
+    traceMinVerticalSeam(energies, seam.data(), mode, context);
+    removeVerticalSeam(image, seam.data(), energies);
+    if (image->width > targetWidth) {
+      updateVerticalCost(energies, seam.data(), context);
+    }
+    ++removed;
+  }
+  deleteCarveContext(context);
+  deleteEnergyMap(energies);
+  return removed;
+}
+
+//transpose, carve vertically, transpose back
+template <class T>
+int carveHorizontalSeams(BasicImage<T>* image, int targetHeight, SeamMode mode) {
+  targetHeight = max(1, targetHeight);
+  if (image->height <= targetHeight) {
+    return 0;
+  }
+  BasicImage<T>* transposed = createBasicImage<T>(image->height, image->width);
+  if (transposed == nullptr) {
+    return 0;
+  }
+  transposeImage(image, transposed);
+  int removed = carveVerticalSeams(transposed, targetHeight, mode);
+  transposeImage(transposed, image);
+  deleteBasicImage(transposed);
+  return removed;
+}
+
+template <class T>
+int carveVerticalSeams(const BasicImage<T>* source, BasicImage<T>* destination, int targetWidth, CarveContext* context) {
+  int count = source->width - max(1, targetWidth);
+  if (count <= 0) {
+    return 0;
+  }
+  EnergyMap* energies = createEnergyMap(source);
+  if (energies == nullptr) {
+    return -1;
+  }
+  vector<int> seam(source->height);
+  const BasicImage<T>* from = source;
+  for (int k = 0; k < count; ++k) {
+    traceMinVerticalSeam(energies, seam.data(), SEAM_DP, context);
+    removeVerticalSeam(from, seam.data(), destination, energies);
+    from = destination;
+    if (k + 1 < count) {
+      updateVerticalCost(energies, seam.data(), context);
+    }
+  }
+  deleteEnergyMap(energies);
+  return count;
+}
+
+//the vertical search on the transposed energies, the removal on the pixels as they are
+template <class T>
+int carveHorizontalSeams(const BasicImage<T>* source, BasicImage<T>* destination, int targetHeight, CarveContext* context) {
+  int count = source->height - max(1, targetHeight);
+  if (count <= 0) {
+    return 0;
+  }
+  EnergyMap* energies = createEnergyMap(source);
+  EnergyMap* transposed = allocateEnergyMap(source->height, source->width, (source->height + 15) / 16 * 16);
+  if (energies == nullptr || transposed == nullptr) {
+    deleteEnergyMap(energies);
+    deleteEnergyMap(transposed);
+    return -1;
+  }
+  transposeEnergyMap(energies, transposed);
+  deleteEnergyMap(energies);
+
+  vector<int> seam(source->width);
+  const BasicImage<T>* from = source;
+  for (int k = 0; k < count; ++k) {
+    traceMinVerticalSeam(transposed, seam.data(), SEAM_DP, context);
+    removeHorizontalSeam(from, seam.data(), destination, transposed);
+    from = destination;
+    if (k + 1 < count) {
+      updateVerticalCost(transposed, seam.data(), context);
+    }
+  }
+  deleteEnergyMap(transposed);
+  return count;
+}
+
+#define INSTANTIATE_PIXEL_FORMAT(T)                                                                     \
+  template BasicImage<T>* createBasicImage<T>(int, int);                                                \
+  template void deleteBasicImage<T>(BasicImage<T>*);                                                    \
+  template BasicImage<T>* convertImage<T>(const Image*);                                                \
+  template void convertImage<T>(const BasicImage<T>*, Image*);                                          \
+  template int energy<T>(const BasicImage<T>*, int, int);                                               \
+  template void computeEnergyRow<T>(const BasicImage<T>*, int, int*);                                   \
+  template EnergyMap* createEnergyMap<T>(const BasicImage<T>*);                                         \
+  template void transposeImage<T>(const BasicImage<T>*, BasicImage<T>*);                                \
+  template void removeVerticalSeam<T>(BasicImage<T>*, const int*, EnergyMap*);                          \
+  template void removeVerticalSeam<T>(const BasicImage<T>*, const int*, BasicImage<T>*, EnergyMap*);    \
+  template void removeHorizontalSeam<T>(const BasicImage<T>*, const int*, BasicImage<T>*, EnergyMap*);  \
+  template int carveVerticalSeams<T>(BasicImage<T>*, int, SeamMode);                                    \
+  template int carveHorizontalSeams<T>(BasicImage<T>*, int, SeamMode);                                  \
+  template int carveVerticalSeams<T>(const BasicImage<T>*, BasicImage<T>*, int, CarveContext*);         \
+  template int carveHorizontalSeams<T>(const BasicImage<T>*, BasicImage<T>*, int, CarveContext*);
+
+INSTANTIATE_PIXEL_FORMAT(RGB8)
+INSTANTIATE_PIXEL_FORMAT(RGBA8)
+INSTANTIATE_PIXEL_FORMAT(Gray8)
+INSTANTIATE_PIXEL_FORMAT(RGB16)
@@ -0,0 +1,129 @@
+#ifndef PIXELFORMAT_H
+#define PIXELFORMAT_H
+
+#include "functions.h"
+
+// compact pixel formats for the templated carving path. The int API in functions.h is the
+// Pixel instance of the same image layout (12 bytes a pixel); these store 1-6 bytes a pixel,
+// so an image fits 2-12x more pixels per cache line and seam compaction moves that much
+// less memory. Each format's energy and compaction loops are specialized at compile time.
+//
+// PixelFormat<T> describes a format:
+//   maxval            largest sample value
+//   gradient(a, b)    squared colour difference between two pixels, the dual-gradient term
+//   fromPixel(p)      the int Pixel p (samples 0-maxval) in this format, clamped
+//   toPixel(p)        back to an int Pixel
+//   name              for reports
+
+struct RGB8 { unsigned char r, g, b; };
+// a is padding to 4 bytes a pixel; it is carried along but has no energy
+struct RGBA8 { unsigned char r, g, b, a; };
+// luminance only, (299 r + 587 g + 114 b) / 1000; toPixel gives a grey Pixel
+struct Gray8 { unsigned char v; };
+// full 16-bit samples, for images loaded with loadImage(filename, image, 65535)
+struct RGB16 { unsigned short r, g, b; };
+
+template <class T> struct PixelFormat;
+
+inline int clampSample(int value, int maxval) {
+  return value < 0 ? 0 : (value > maxval ? maxval : value);
+}
+
+template <> struct PixelFormat<RGB8> {
+  static const int maxval = 255;
+  static int gradient(const RGB8& a, const RGB8& b) {
+    int r = a.r - b.r, g = a.g - b.g, bl = a.b - b.b;
+    return r * r + g * g + bl * bl;
+  }
+  static RGB8 fromPixel(const Pixel& p) {
+    return { static_cast<unsigned char>(clampSample(p.r, 255)), static_cast<unsigned char>(clampSample(p.g, 255)),
+             static_cast<unsigned char>(clampSample(p.b, 255)) };
+  }
+  static Pixel toPixel(const RGB8& p) { return { p.r, p.g, p.b }; }
+  static const char* name() { return "rgb8"; }
+};
+
+template <> struct PixelFormat<RGBA8> {
+  static const int maxval = 255;
+  static int gradient(const RGBA8& a, const RGBA8& b) {
+    int r = a.r - b.r, g = a.g - b.g, bl = a.b - b.b;
+    return r * r + g * g + bl * bl;
+  }
+  static RGBA8 fromPixel(const Pixel& p) {
+    return { static_cast<unsigned char>(clampSample(p.r, 255)), static_cast<unsigned char>(clampSample(p.g, 255)),
+             static_cast<unsigned char>(clampSample(p.b, 255)), 255 };
+  }
+  static Pixel toPixel(const RGBA8& p) { return { p.r, p.g, p.b }; }
+  static const char* name() { return "rgba8"; }
+};
+
+template <> struct PixelFormat<Gray8> {
+  static const int maxval = 255;
+  static int gradient(const Gray8& a, const Gray8& b) {
+    int v = a.v - b.v;
+    return v * v;
+  }
+  static Gray8 fromPixel(const Pixel& p) {
+    return { static_cast<unsigned char>(clampSample((clampSample(p.r, 255) * 299 + clampSample(p.g, 255) * 587
+                                                     + clampSample(p.b, 255) * 114 + 500) / 1000, 255)) };
+  }
+  static Pixel toPixel(const Gray8& p) { return { p.v, p.v, p.v }; }
+  static const char* name() { return "gray8"; }
+};
+
+template <> struct PixelFormat<RGB16> {
+  static const int maxval = 65535;
+  // squares of 16-bit differences overflow an int; >> 16 brings them back to about the
+  // 8-bit scale (257^2 is just over 2^16), so energies still fit an EnergyMap
+  static int gradient(const RGB16& a, const RGB16& b) {
+    long long r = a.r - b.r, g = a.g - b.g, bl = a.b - b.b;
+    return static_cast<int>((r * r + g * g + bl * bl) >> 16);
+  }
+  static RGB16 fromPixel(const Pixel& p) {
+    return { static_cast<unsigned short>(clampSample(p.r, 65535)), static_cast<unsigned short>(clampSample(p.g, 65535)),
+             static_cast<unsigned short>(clampSample(p.b, 65535)) };
+  }
+  static Pixel toPixel(const RGB16& p) { return { p.r, p.g, p.b }; }
+  static const char* name() { return "rgb16"; }
+};
+
+// the functions below are instantiated for RGB8, RGBA8, Gray8 and RGB16 in pixelformat.cpp
+// and behave like their Image counterparts in functions.h
+
+template <class T> BasicImage<T>* createBasicImage(int width, int height);
+template <class T> void deleteBasicImage(BasicImage<T>* image);
+
+// new compact copy of image, nullptr if it can't be allocated
+template <class T> BasicImage<T>* convertImage(const Image* image);
+// source back into destination, which must have been created at least as big
+template <class T> void convertImage(const BasicImage<T>* source, Image* destination);
+
+template <class T> int energy(const BasicImage<T>* image, int x, int y);
+template <class T> void computeEnergyRow(const BasicImage<T>* image, int y, int* out);
+template <class T> EnergyMap* createEnergyMap(const BasicImage<T>* image);
+
+template <class T> void transposeImage(const BasicImage<T>* source, BasicImage<T>* destination);
+template <class T> void removeVerticalSeam(BasicImage<T>* image, const int* verticalSeam, EnergyMap* energies = nullptr);
+// the same with the pixels of source written to destination, which may be source itself; a
+// carve out of a buffer that must stay untouched reads it once, on the first seam
+template <class T> void removeVerticalSeam(const BasicImage<T>* source, const int* verticalSeam, BasicImage<T>* destination,
+                                           EnergyMap* energies = nullptr);
+// a horizontal seam (horizontalSeam[col] = row removed) without a transpose: a row keeps its
+// pixels where the seam is further down and takes the next row's where it isn't, so the rows
+// stream top to bottom and destination may be source. transposedEnergies are the energies of
+// source transposed, as the vertical search sees horizontal seams, and end up destination's
+template <class T> void removeHorizontalSeam(const BasicImage<T>* source, const int* horizontalSeam, BasicImage<T>* destination,
+                                             EnergyMap* transposedEnergies = nullptr);
+
+// one seam at a time by the DP (or the pyramid search); returns the number of seams removed
+template <class T> int carveVerticalSeams(BasicImage<T>* image, int targetWidth, SeamMode mode = SEAM_DP);
+template <class T> int carveHorizontalSeams(BasicImage<T>* image, int targetHeight, SeamMode mode = SEAM_DP);
+
+// exact seams from source into destination (which may be source, and must hold source's
+// size): the pixels are only ever moved within the two buffers, horizontal seams included.
+// Nothing is written when there is nothing to remove. Returns the number of seams removed,
+// or -1 if the energy maps couldn't be allocated
+template <class T> int carveVerticalSeams(const BasicImage<T>* source, BasicImage<T>* destination, int targetWidth, CarveContext* context);
+template <class T> int carveHorizontalSeams(const BasicImage<T>* source, BasicImage<T>* destination, int targetHeight, CarveContext* context);
+
+#endif
@@ -0,0 +1,290 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <climits>
+#include "removalindex.h"
+
+using namespace std;
+
+static const char INDEX_MAGIC[8] = { 'S', 'E', 'A', 'M', 'I', 'D', 'X', '1' };
+static const size_t INDEX_HEADER_BYTES = sizeof(INDEX_MAGIC) + 5 * 4;
+
+//carve removals exact seams off work, the same ones carveVerticalSeams would take,
+//writing order[row * width + original col] = number of the seam that took the pixel
+static void recordVerticalRemovals(Image* work, int removals, int* order) {
+  int width = work->width;
+  int height = work->height;
+
+  //origins[row * width + col] is the original column of work's pixel (col, row),
+  //compacted alongside the image so seams can be traced back to the original
+  vector<int> origins(static_cast<size_t>(width) * height);
+  for (int row = 0; row < height; ++row) {
+    for (int col = 0; col < width; ++col) {
+      origins[static_cast<size_t>(row) * width + col] = col;
+      order[static_cast<size_t>(row) * width + col] = removals;
+    }
+  }
+
+  EnergyMap* energies = createEnergyMap(work);
+  for (int seamNumber = 0; seamNumber < removals; ++seamNumber) {
+    int* seam = findMinVerticalSeam(work, SEAM_DP, energies);
+    int current = work->width;
+    for (int row = 0; row < height; ++row) {
+      int* line = &origins[static_cast<size_t>(row) * width];
+      int col = seam[row];
+      order[static_cast<size_t>(row) * width + line[col]] = seamNumber;
+      memmove(line + col, line + col + 1, sizeof(int) * (current - col - 1));
+    }
+    removeVerticalSeam(work, seam, energies);
+    deleteSeam(seam);
+  }
+  deleteEnergyMap(energies);
+}
+
+RemovalIndex* createRemovalIndex(const Image* image, int minimumWidth, int minimumHeight) {
+  int width = image->width;
+  int height = image->height;
+  size_t pixels = static_cast<size_t>(width) * height;
+  minimumWidth = max(1, min(minimumWidth, width));
+  minimumHeight = max(1, min(minimumHeight, height));
+
+  RemovalIndex* index = new (std::nothrow) RemovalIndex{ width, height, width - minimumWidth, height - minimumHeight, nullptr, nullptr };
+  if (index == nullptr) {
+    return nullptr;
+  }
+  index->columnOrder = new (std::nothrow) int[pixels];
+  if (index->rowsRemoved > 0) {
+    index->rowOrder = new (std::nothrow) int[pixels];
+  }
+  Image* work = createImage(width, height);
+  if (index->columnOrder == nullptr || (index->rowsRemoved > 0 && index->rowOrder == nullptr) || work == nullptr) {
+    deleteImage(work);
+    deleteRemovalIndex(index);
+    return nullptr;
+  }
+  copyImage(image, work);
+  recordVerticalRemovals(work, index->columnsRemoved, index->columnOrder);
+  deleteImage(work);
+
+  //rows: the same carve on the transposed original, with the order transposed back
+  if (index->rowsRemoved > 0) {
+    Image* transposed = createImage(height, width);
+    if (transposed == nullptr) {
+      deleteRemovalIndex(index);
+      return nullptr;
+    }
+    transposeImage(image, transposed);
+    vector<int> transposedOrder(pixels);
+    recordVerticalRemovals(transposed, index->rowsRemoved, transposedOrder.data());
+    deleteImage(transposed);
+    for (int row = 0; row < height; ++row) {
+      for (int col = 0; col < width; ++col) {
+        index->rowOrder[static_cast<size_t>(row) * width + col] = transposedOrder[static_cast<size_t>(col) * height + row];
+      }
+    }
+  }
+  return index;
+}
+
+void deleteRemovalIndex(RemovalIndex* index) {
+  if (index == nullptr) {
+    return;
+  }
+  delete[] index->columnOrder;
+  delete[] index->rowOrder;
+  delete index;
+}
+
+static void putValue(vector<unsigned char>& bytes, unsigned value, int size) {
+  for (int i = 0; i < size; ++i) {
+    bytes.push_back(static_cast<unsigned char>(value >> (8 * i)));
+  }
+}
+
+static unsigned getValue(const unsigned char* bytes, int size) {
+  unsigned value = 0;
+  for (int i = 0; i < size; ++i) {
+    value |= static_cast<unsigned>(bytes[i]) << (8 * i);
+  }
+  return value;
+}
+
+bool saveRemovalIndex(string filename, const RemovalIndex* index) {
+  size_t pixels = static_cast<size_t>(index->width) * index->height;
+  int entryBytes = max(index->columnsRemoved, index->rowsRemoved) <= 65535 ? 2 : 4;
+  int orders = index->rowOrder != nullptr ? 2 : 1;
+
+  vector<unsigned char> bytes(INDEX_MAGIC, INDEX_MAGIC + sizeof(INDEX_MAGIC));
+  bytes.reserve(INDEX_HEADER_BYTES + orders * pixels * entryBytes);
+  putValue(bytes, index->width, 4);
+  putValue(bytes, index->height, 4);
+  putValue(bytes, index->columnsRemoved, 4);
+  putValue(bytes, index->rowOrder != nullptr ? index->rowsRemoved : 0, 4);
+  putValue(bytes, entryBytes, 4);
+  for (size_t i = 0; i < pixels; ++i) {
+    putValue(bytes, index->columnOrder[i], entryBytes);
+  }
+  if (index->rowOrder != nullptr) {
+    for (size_t i = 0; i < pixels; ++i) {
+      putValue(bytes, index->rowOrder[i], entryBytes);
+    }
+  }
+
+  ofstream out(filename, ios::binary);
+  if (!out.is_open()) {
+    cout << "Error: failed to open index file - " << filename << endl;
+    return false;
+  }
+  out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  if (!out) {
+    cout << "Error: failed to write index file - " << filename << endl;
+    return false;
+  }
+  return true;
+}
+
+RemovalIndex* loadRemovalIndex(string filename) {
+  ifstream in(filename, ios::binary);
+  if (!in.is_open()) {
+    cout << "Error: failed to open index file - " << filename << endl;
+    return nullptr;
+  }
+  vector<unsigned char> bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+  if (bytes.size() < INDEX_HEADER_BYTES || memcmp(bytes.data(), INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+    cout << "Error: not a seam index file - " << filename << endl;
+    return nullptr;
+  }
+  const unsigned char* header = bytes.data() + sizeof(INDEX_MAGIC);
+  unsigned width = getValue(header, 4);
+  unsigned height = getValue(header + 4, 4);
+  unsigned columnsRemoved = getValue(header + 8, 4);
+  unsigned rowsRemoved = getValue(header + 12, 4);
+  unsigned entryBytes = getValue(header + 16, 4);
+  if (width == 0 || height == 0 || width > INT_MAX || height > INT_MAX || columnsRemoved >= width || rowsRemoved >= height
+      || (entryBytes != 2 && entryBytes != 4)) {
+    cout << "Error: invalid seam index header - " << filename << endl;
+    return nullptr;
+  }
+  size_t pixels = static_cast<size_t>(width) * height;
+  int orders = rowsRemoved > 0 ? 2 : 1;
+  if (bytes.size() != INDEX_HEADER_BYTES + orders * pixels * entryBytes) {
+    cout << "Error: seam index has the wrong size for a " << width << "x" << height << " image - " << filename << endl;
+    return nullptr;
+  }
+
+  RemovalIndex* index = new (std::nothrow) RemovalIndex{ static_cast<int>(width), static_cast<int>(height),
+                                                         static_cast<int>(columnsRemoved), static_cast<int>(rowsRemoved), nullptr, nullptr };
+  if (index == nullptr) {
+    return nullptr;
+  }
+  index->columnOrder = new (std::nothrow) int[pixels];
+  if (rowsRemoved > 0) {
+    index->rowOrder = new (std::nothrow) int[pixels];
+  }
+  if (index->columnOrder == nullptr || (rowsRemoved > 0 && index->rowOrder == nullptr)) {
+    deleteRemovalIndex(index);
+    return nullptr;
+  }
+
+  const unsigned char* entries = bytes.data() + INDEX_HEADER_BYTES;
+  for (int which = 0; which < orders; ++which) {
+    int* order = which == 0 ? index->columnOrder : index->rowOrder;
+    unsigned limit = which == 0 ? columnsRemoved : rowsRemoved;
+    for (size_t i = 0; i < pixels; ++i, entries += entryBytes) {
+      unsigned value = getValue(entries, entryBytes);
+      if (value > limit) {
+        cout << "Error: seam index entry out of range - " << filename << endl;
+        deleteRemovalIndex(index);
+        return nullptr;
+      }
+      order[i] = static_cast<int>(value);
+    }
+  }
+  return index;
+}
+
+bool applyRemovalIndex(const Image* source, const RemovalIndex* index, int targetWidth, int targetHeight, Image* destination) {
+  int width = index->width;
+  int height = index->height;
+  if (source->width != width || source->height != height) {
+    cout << "Error: seam index is for a " << width << "x" << height << " image, not " << source->width << "x" << source->height << endl;
+    return false;
+  }
+  if (targetWidth > width || targetWidth < width - index->columnsRemoved) {
+    cout << "Error: target width must be between " << width - index->columnsRemoved << " and " << width << ". You entered " << targetWidth << endl;
+    return false;
+  }
+  if (targetHeight > height || targetHeight < height - index->rowsRemoved) {
+    cout << "Error: target height must be between " << height - index->rowsRemoved << " and " << height << ". You entered " << targetHeight << endl;
+    return false;
+  }
+
+  //width: a pixel stays if the seam that took it is numbered firstKept or later (or none did),
+  //which leaves exactly targetWidth pixels in every row. Row orders travel with their pixels
+  bool narrowOnly = (targetHeight == height);
+  Image* narrowed = narrowOnly ? destination : createImage(targetWidth, height);
+  if (narrowed == nullptr) {
+    return false;
+  }
+  int firstKept = width - targetWidth;
+  vector<int> rowOrders(narrowOnly ? 0 : static_cast<size_t>(targetWidth) * height);
+  for (int row = 0; row < height; ++row) {
+    const Pixel* in = imageRow(source, row);
+    Pixel* out = imageRow(narrowed, row);
+    const int* order = &index->columnOrder[static_cast<size_t>(row) * width];
+    int kept = 0;
+    for (int col = 0; col < width; ++col) {
+      if (order[col] >= firstKept) {
+        if (!narrowOnly) {
+          rowOrders[static_cast<size_t>(row) * targetWidth + kept] = index->rowOrder[static_cast<size_t>(row) * width + col];
+        }
+        out[kept++] = in[col];
+      }
+    }
+  }
+  narrowed->width = targetWidth;
+  narrowed->height = height;
+  if (narrowOnly) {
+    return true;
+  }
+
+  //height: per output column, the row order at or above which targetHeight pixels remain.
+  //Without a width change every column holds distinct orders and this is exact; otherwise
+  //orders can repeat and ties are kept from the top down
+  int firstKeptRow = height - targetHeight;
+  vector<int> threshold(targetWidth);
+  vector<int> ties(targetWidth);
+  vector<int> column(height);
+  for (int col = 0; col < targetWidth; ++col) {
+    for (int row = 0; row < height; ++row) {
+      column[row] = rowOrders[static_cast<size_t>(row) * targetWidth + col];
+    }
+    nth_element(column.begin(), column.begin() + firstKeptRow, column.end());
+    threshold[col] = column[firstKeptRow];
+    int above = 0;
+    for (int row = firstKeptRow + 1; row < height; ++row) {
+      above += column[row] > threshold[col];
+    }
+    ties[col] = targetHeight - above;
+  }
+
+  vector<int> filled(targetWidth, 0);
+  for (int row = 0; row < height; ++row) {
+    const Pixel* in = imageRow(narrowed, row);
+    const int* order = &rowOrders[static_cast<size_t>(row) * targetWidth];
+    for (int col = 0; col < targetWidth; ++col) {
+      if (order[col] > threshold[col] || (order[col] == threshold[col] && ties[col]-- > 0)) {
+        imageRow(destination, filled[col]++)[col] = in[col];
+      }
+    }
+  }
+  destination->width = targetWidth;
+  destination->height = targetHeight;
+  deleteImage(narrowed);
+  return true;
+}
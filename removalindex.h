@@ -0,0 +1,36 @@
+#ifndef REMOVALINDEX_H
+#define REMOVALINDEX_H
+
+#include <string>
+#include "functions.h"
+
+// when carving removed each pixel of an image, so it can be retargeted to any size
+// later with one filtering pass instead of another carve
+struct RemovalIndex {
+  int width;         // size of the original image
+  int height;
+  int columnsRemoved; // vertical seams recorded: any target width >= width - columnsRemoved works
+  int rowsRemoved;    // horizontal seams recorded, 0 if there is no row order
+  int* columnOrder;   // [row * width + col] = vertical seam that removed the pixel, columnsRemoved if none did
+  int* rowOrder;      // [row * width + col] = horizontal seam that removed the pixel, nullptr if not recorded
+};
+
+// carve exact seams one at a time down to minimumWidth (and, separately on the original,
+// down to minimumHeight) and record the order the pixels went in
+RemovalIndex* createRemovalIndex(const Image* image, int minimumWidth, int minimumHeight);
+void deleteRemovalIndex(RemovalIndex* index);
+
+// sidecar file: "SEAMIDX1", then width, height, columnsRemoved, rowsRemoved and bytes per
+// entry as little-endian uint32, then the column order and the row order (if any) as
+// little-endian uint16 entries, or uint32 once more than 65535 seams were recorded
+bool saveRemovalIndex(std::string filename, const RemovalIndex* index);
+RemovalIndex* loadRemovalIndex(std::string filename);
+
+// destination gets source (the image the index was built from) at targetWidth x targetHeight.
+// Width is exact: the same pixels carveVerticalSeams would keep. Height is approximate
+// when both change: each output column keeps its targetHeight pixels with the latest
+// row order, which was recorded on the original image rather than the narrowed one.
+// destination must have been created at least targetWidth x targetHeight
+bool applyRemovalIndex(const Image* source, const RemovalIndex* index, int targetWidth, int targetHeight, Image* destination);
+
+#endif
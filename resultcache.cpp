@@ -0,0 +1,298 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <filesystem>
+#include "resultcache.h"
+#include "internal.h"
+
+using namespace std;
+
+//one cached plane: a result (3 values a pixel) or an energy map (1 value a pixel), rows packed
+struct CacheEntry {
+  string key;
+  int channels;
+  int width;
+  int height;
+  vector<int> values;
+};
+
+struct ResultCache {
+  explicit ResultCache(const CacheOptions& options)
+      : lock(), recent(), index(), limit(options.memoryMB * (1LL << 20)), directory(options.directory), energies(options.energies),
+        stats{ 0, 0, 0, 0, 0, 0, 0, 0 } {}
+
+  mutex lock;
+  list<CacheEntry> recent;                                   // most recently used first
+  unordered_map<string, list<CacheEntry>::iterator> index;  // key -> its entry in recent
+  long long limit;                                           // bytes the memory tier may hold
+  string directory;
+  bool energies;
+  CacheStats stats;
+};
+
+ResultCache* createResultCache(const CacheOptions& options) {
+  if (!options.directory.empty()) {
+    error_code error;
+    filesystem::create_directories(options.directory, error);
+    if (!filesystem::is_directory(options.directory)) {
+      cout << "Error: failed to create cache directory - " << options.directory << endl;
+      return nullptr;
+    }
+  }
+  return new ResultCache(options);
+}
+
+void deleteResultCache(ResultCache* cache) {
+  delete cache;
+}
+
+static long long entryBytes(const CacheEntry& entry) {
+  return static_cast<long long>(entry.values.size() * sizeof(int) + entry.key.size() + sizeof(CacheEntry));
+}
+
+//one 64-bit value folded into the hash: multiply, rotate, multiply, as in the xxHash/murmur family
+static unsigned long long mixHash(unsigned long long hash, unsigned long long value) {
+  hash ^= value * 0x9E3779B97F4A7C15ULL;
+  hash = (hash << 31) | (hash >> 33);
+  return hash * 0xC2B2AE3D27D4EB4FULL;
+}
+
+unsigned long long hashImage(const Image* image) {
+  unsigned long long hash = mixHash(0x27D4EB2F165667C5ULL, (static_cast<unsigned long long>(image->width) << 32) | image->height);
+  for (int row = 0; row < image->height; ++row) {
+    const Pixel* line = imageRow(image, row);
+    for (int col = 0; col < image->width; ++col) {
+      //samples are at most 16 bits, so each gets 21 of the 63
+      unsigned long long value = static_cast<unsigned long long>(line[col].r & 0x1FFFFF)
+                               | static_cast<unsigned long long>(line[col].g & 0x1FFFFF) << 21
+                               | static_cast<unsigned long long>(line[col].b & 0x1FFFFF) << 42;
+      hash = mixHash(hash, value);
+    }
+  }
+  //final avalanche so every input bit reaches every output bit
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 29;
+  return hash;
+}
+
+static string hexString(unsigned long long value) {
+  stringstream text;
+  text << std::hex << value;
+  return text.str();
+}
+
+string cacheKey(unsigned long long pixelHash, int width, int height, int targetWidth, int targetHeight, const string& parameters) {
+  stringstream key;
+  key << "carve " << hexString(pixelHash) << " " << width << "x" << height << " -> " << targetWidth << "x" << targetHeight << " " << parameters;
+  return key.str();
+}
+
+string energyKey(unsigned long long pixelHash, int width, int height, const string& parameters) {
+  stringstream key;
+  key << "energy " << hexString(pixelHash) << " " << width << "x" << height << " " << parameters;
+  return key.str();
+}
+
+//file of key in the cache directory, named by a hash of the key; the key itself is the file's
+//second line, so two keys with the same name can't be mistaken for each other
+static filesystem::path entryPath(const ResultCache* cache, const string& key) {
+  unsigned long long hash = 0xCBF29CE484222325ULL;
+  for (char c : key) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001B3ULL;
+  }
+  return filesystem::path(cache->directory) / (hexString(hash) + ".cache");
+}
+
+//"SEAMCACHE channels width height\nkey\n" and then the values as raw ints. Written to a
+//temporary name first and renamed, so a reader never sees half an entry
+static void writeEntry(ResultCache* cache, const CacheEntry& entry) {
+  filesystem::path path = entryPath(cache, entry.key);
+  stringstream temporary;
+  temporary << path.string() << "." << hash<thread::id>()(this_thread::get_id()) << ".tmp";
+  {
+    ofstream file(temporary.str(), ios::binary);
+    if (!file.is_open()) {
+      cout << "Error: failed to write cache entry - " << temporary.str() << endl;
+      return;
+    }
+    file << "SEAMCACHE " << entry.channels << " " << entry.width << " " << entry.height << "\n" << entry.key << "\n";
+    file.write(reinterpret_cast<const char*>(entry.values.data()), static_cast<streamsize>(entry.values.size() * sizeof(int)));
+    if (!file) {
+      cout << "Error: failed to write cache entry - " << temporary.str() << endl;
+      return;
+    }
+  }
+  error_code error;
+  filesystem::rename(temporary.str(), path, error);
+  if (error) {
+    filesystem::remove(temporary.str(), error);
+  }
+}
+
+static bool readEntry(ResultCache* cache, const string& key, CacheEntry& entry) {
+  ifstream file(entryPath(cache, key), ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  string magic, storedKey;
+  if (!(file >> magic >> entry.channels >> entry.width >> entry.height) || magic != "SEAMCACHE" || file.get() != '\n'
+      || !getline(file, storedKey) || storedKey != key || entry.channels < 1 || entry.width < 1 || entry.height < 1) {
+    return false;
+  }
+  entry.key = key;
+  entry.values.resize(static_cast<size_t>(entry.channels) * entry.width * entry.height);
+  file.read(reinterpret_cast<char*>(entry.values.data()), static_cast<streamsize>(entry.values.size() * sizeof(int)));
+  return static_cast<bool>(file);
+}
+
+//entry to the front of the memory tier, evicting from the back until it fits. Entries bigger
+//than the whole tier stay on disk only. Called with the lock held
+static void remember(ResultCache* cache, CacheEntry entry) {
+  long long bytes = entryBytes(entry);
+  if (bytes > cache->limit) {
+    return;
+  }
+  auto found = cache->index.find(entry.key);
+  if (found != cache->index.end()) {
+    cache->stats.bytes -= entryBytes(*found->second);
+    cache->recent.erase(found->second);
+    cache->index.erase(found);
+  }
+  while (!cache->recent.empty() && cache->stats.bytes + bytes > cache->limit) {
+    cache->stats.bytes -= entryBytes(cache->recent.back());
+    cache->index.erase(cache->recent.back().key);
+    cache->recent.pop_back();
+    cache->stats.evictions += 1;
+  }
+  cache->recent.push_front(move(entry));
+  cache->index[cache->recent.front().key] = cache->recent.begin();
+  cache->stats.bytes += bytes;
+  cache->stats.entries = static_cast<int>(cache->recent.size());
+}
+
+//entry under key from memory, or from disk (and then into memory); false if neither has it
+static bool findEntry(ResultCache* cache, const string& key, CacheEntry& entry, bool& fromDisk) {
+  fromDisk = false;
+  {
+    lock_guard<mutex> guard(cache->lock);
+    auto found = cache->index.find(key);
+    if (found != cache->index.end()) {
+      cache->recent.splice(cache->recent.begin(), cache->recent, found->second);
+      entry = *found->second;
+      return true;
+    }
+  }
+  if (cache->directory.empty() || !readEntry(cache, key, entry)) {
+    return false;
+  }
+  fromDisk = true;
+  lock_guard<mutex> guard(cache->lock);
+  remember(cache, entry);
+  return true;
+}
+
+static void storeEntry(ResultCache* cache, CacheEntry entry) {
+  if (!cache->directory.empty()) {
+    writeEntry(cache, entry);
+  }
+  lock_guard<mutex> guard(cache->lock);
+  remember(cache, move(entry));
+}
+
+bool cacheLookup(ResultCache* cache, const string& key, Image* image) {
+  CacheEntry entry = { "", 0, 0, 0, {} };
+  bool fromDisk;
+  bool hit = findEntry(cache, key, entry, fromDisk) && entry.channels == 3;
+  {
+    lock_guard<mutex> guard(cache->lock);
+    (hit ? cache->stats.hits : cache->stats.misses) += 1;
+    cache->stats.diskHits += hit && fromDisk ? 1 : 0;
+  }
+  if (!hit) {
+    return false;
+  }
+
+  image->width = entry.width;
+  image->height = entry.height;
+  const int* values = entry.values.data();
+  for (int row = 0; row < entry.height; ++row) {
+    Pixel* line = imageRow(image, row);
+    for (int col = 0; col < entry.width; ++col, values += 3) {
+      line[col] = { values[0], values[1], values[2] };
+    }
+  }
+  return true;
+}
+
+void cacheStore(ResultCache* cache, const string& key, const Image* image) {
+  CacheEntry entry = { key, 3, image->width, image->height, vector<int>(3 * static_cast<size_t>(image->width) * image->height) };
+  int* values = entry.values.data();
+  for (int row = 0; row < image->height; ++row) {
+    const Pixel* line = imageRow(image, row);
+    for (int col = 0; col < image->width; ++col, values += 3) {
+      values[0] = line[col].r;
+      values[1] = line[col].g;
+      values[2] = line[col].b;
+    }
+  }
+  storeEntry(cache, move(entry));
+}
+
+bool cacheKeepsEnergies(const ResultCache* cache) {
+  return cache->energies;
+}
+
+EnergyMap* cacheLookupEnergies(ResultCache* cache, const string& key) {
+  if (!cache->energies) {
+    return nullptr;
+  }
+  CacheEntry entry = { "", 0, 0, 0, {} };
+  bool fromDisk;
+  bool hit = findEntry(cache, key, entry, fromDisk) && entry.channels == 1;
+  {
+    lock_guard<mutex> guard(cache->lock);
+    (hit ? cache->stats.energyHits : cache->stats.energyMisses) += 1;
+  }
+  if (!hit) {
+    return nullptr;
+  }
+
+  EnergyMap* energies = allocateEnergyMap(entry.width, entry.height, entry.width);
+  if (energies != nullptr) {
+    copy(entry.values.begin(), entry.values.end(), energies->values);
+  }
+  return energies;
+}
+
+void cacheStoreEnergies(ResultCache* cache, const string& key, const EnergyMap* energies) {
+  if (!cache->energies) {
+    return;
+  }
+  CacheEntry entry = { key, 1, energies->width, energies->height, vector<int>(static_cast<size_t>(energies->width) * energies->height) };
+  for (int row = 0; row < energies->height; ++row) {
+    copy(energyMapRow(energies, row), energyMapRow(energies, row) + energies->width, entry.values.begin() + static_cast<size_t>(row) * energies->width);
+  }
+  storeEntry(cache, move(entry));
+}
+
+CacheStats cacheStats(ResultCache* cache) {
+  lock_guard<mutex> guard(cache->lock);
+  return cache->stats;
+}
+
+void printCacheStats(ResultCache* cache) {
+  CacheStats stats = cacheStats(cache);
+  cout << "Cache: " << stats.hits << " hits (" << stats.diskHits << " from disk), " << stats.misses << " misses, "
+       << stats.evictions << " evictions, " << stats.entries << " entries in " << stats.bytes << " bytes of memory";
+  if (cache->energies) {
+    cout << "; energy maps " << stats.energyHits << " hits, " << stats.energyMisses << " misses";
+  }
+  cout << endl;
+}
@@ -0,0 +1,58 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <string>
+#include "functions.h"
+
+// carve results kept by content, for traffic that asks for the same (image, target size) over
+// and over. Keys are a hash of the decoded pixels plus the carve's size and parameters, so the
+// same picture under another file name still hits. Entries live in an in-memory tier that
+// evicts the least recently used once it is over its size, and optionally in a directory that
+// keeps every entry written to it (nothing is evicted there; empty it to start over). A memory
+// miss that hits on disk brings the entry back into memory. Besides finished results the cache
+// can keep each input's first energy map, which a carve to a new target can start from (see
+// seedEnergies). One cache can be shared by any number of threads.
+struct CacheOptions {
+  long long memoryMB;     // size of the in-memory tier, 0 = none
+  std::string directory;  // on-disk tier, "" = none; created if missing
+  bool energies;          // keep energy maps as well as results
+};
+
+struct CacheStats {
+  long long hits;         // results found, in memory or on disk
+  long long misses;       // results looked up and not found
+  long long diskHits;     // of the hits, the ones read back from the directory
+  long long evictions;    // entries pushed out of memory to make room
+  long long energyHits;   // energy maps found
+  long long energyMisses;
+  long long bytes;        // held in memory now
+  int entries;
+};
+
+struct ResultCache;
+ResultCache* createResultCache(const CacheOptions& options);  // null if the directory can't be made
+void deleteResultCache(ResultCache* cache);
+
+// 64-bit hash of the pixels in use, row by row, so two images with the same pixels hash the
+// same whatever their strides
+unsigned long long hashImage(const Image* image);
+// key of one carve of an image with pixelHash; parameters holds whatever else changes the result
+std::string cacheKey(unsigned long long pixelHash, int width, int height, int targetWidth, int targetHeight,
+                     const std::string& parameters);
+// key of an image's energy map; parameters holds whatever changes the energies
+std::string energyKey(unsigned long long pixelHash, int width, int height, const std::string& parameters);
+
+// on a hit the result is copied into image, which must have been created at least as big, and
+// image takes on its size. false on a miss, image untouched
+bool cacheLookup(ResultCache* cache, const std::string& key, Image* image);
+void cacheStore(ResultCache* cache, const std::string& key, const Image* image);
+// a copy of the energy map stored under key (delete it with deleteEnergyMap), null on a miss
+// or when the cache doesn't keep energies
+EnergyMap* cacheLookupEnergies(ResultCache* cache, const std::string& key);
+void cacheStoreEnergies(ResultCache* cache, const std::string& key, const EnergyMap* energies);
+bool cacheKeepsEnergies(const ResultCache* cache);
+
+CacheStats cacheStats(ResultCache* cache);
+void printCacheStats(ResultCache* cache);
+
+#endif
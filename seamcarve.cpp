@@ -0,0 +1,166 @@
+#include <cstring>
+#include <cstdint>
+#include <new>
+#include "seamcarve.h"
+#include "pixelformat.h"
+
+using namespace std;
+
+struct SeamcarveHandle {
+  CarveContext* context;
+};
+
+//no exception may cross into a C caller: every exported function catches them all, and the
+//ones that return a status map them onto it (an allocation that threw is out of memory)
+
+SeamcarveHandle* seamcarveCreate(void) {
+  try {
+    CarveContext* context = createCarveContext();
+    if (context == nullptr) {
+      return nullptr;
+    }
+    SeamcarveHandle* handle = new (std::nothrow) SeamcarveHandle{ context };
+    if (handle == nullptr) {
+      deleteCarveContext(context);
+    }
+    return handle;
+  }
+  catch (...) {
+    return nullptr;
+  }
+}
+
+void seamcarveDestroy(SeamcarveHandle* handle) {
+  if (handle == nullptr) {
+    return;
+  }
+  try {
+    deleteCarveContext(handle->context);
+  }
+  catch (...) {
+  }
+  delete handle;
+}
+
+void seamcarveSetThreads(int threads) {
+  try {
+    setThreadCount(threads);
+  }
+  catch (...) {
+  }
+}
+
+static size_t pixelSize(SeamcarveFormat format) {
+  switch (format) {
+    case SEAMCARVE_RGB8: return sizeof(RGB8);
+    case SEAMCARVE_RGBA8: return sizeof(RGBA8);
+    case SEAMCARVE_GRAY8: return sizeof(Gray8);
+    case SEAMCARVE_RGB16: return sizeof(RGB16);
+  }
+  return 0;
+}
+
+//image checked against its own format's layout, before anything is read from it
+static SeamcarveStatus checkImage(const SeamcarveImage* image) {
+  if (image == nullptr || image->pixels == nullptr || image->width < 1 || image->height < 1) {
+    return SEAMCARVE_INVALID_ARGUMENT;
+  }
+  size_t size = pixelSize(image->format);
+  if (size == 0) {
+    return SEAMCARVE_INVALID_ARGUMENT;
+  }
+  if (image->stride < static_cast<ptrdiff_t>(size * image->width) || image->stride % static_cast<ptrdiff_t>(size) != 0
+      || image->stride / static_cast<ptrdiff_t>(size) > INT32_MAX
+      || (image->format == SEAMCARVE_RGB16 && reinterpret_cast<uintptr_t>(image->pixels) % alignof(RGB16) != 0)) {
+    return SEAMCARVE_INVALID_STRIDE;
+  }
+  return SEAMCARVE_OK;
+}
+
+//the caller's buffer seen as a BasicImage, no pixels move
+template <class T>
+static BasicImage<T> wrap(const SeamcarveImage* image) {
+  return { image->width, image->height, static_cast<int>(image->stride / static_cast<ptrdiff_t>(sizeof(T))),
+           static_cast<T*>(image->pixels) };
+}
+
+//vertical seams from input into output, then horizontal ones on whichever holds the pixels by
+//then; with nothing to remove the pixels are copied across, unless input is output
+template <class T>
+static SeamcarveStatus carve(CarveContext* context, const SeamcarveImage* input, SeamcarveImage* output, int targetWidth, int targetHeight) {
+  BasicImage<T> source = wrap<T>(input);
+  BasicImage<T> destination = wrap<T>(output);
+  const BasicImage<T>* from = &source;
+  if (from->width > targetWidth) {
+    if (carveVerticalSeams(from, &destination, targetWidth, context) < 0) {
+      return SEAMCARVE_OUT_OF_MEMORY;
+    }
+    from = &destination;
+  }
+  if (from->height > targetHeight) {
+    if (carveHorizontalSeams(from, &destination, targetHeight, context) < 0) {
+      return SEAMCARVE_OUT_OF_MEMORY;
+    }
+    from = &destination;
+  }
+  if (from != &destination && source.pixels != destination.pixels) {
+    for (int row = 0; row < targetHeight; ++row) {
+      memcpy(static_cast<void*>(imageRow(&destination, row)), imageRow(&source, row), sizeof(T) * targetWidth);
+    }
+  }
+  output->width = targetWidth;
+  output->height = targetHeight;
+  return SEAMCARVE_OK;
+}
+
+SeamcarveStatus seamcarveCarveInto(SeamcarveHandle* handle, const SeamcarveImage* input, SeamcarveImage* output,
+                                   int targetWidth, int targetHeight) {
+  try {
+    if (handle == nullptr) {
+      return SEAMCARVE_INVALID_ARGUMENT;
+    }
+    SeamcarveStatus status = checkImage(input);
+    if (status == SEAMCARVE_OK) {
+      status = checkImage(output);
+    }
+    if (status != SEAMCARVE_OK) {
+      return status;
+    }
+    if (targetWidth < 1 || targetHeight < 1 || targetWidth > input->width || targetHeight > input->height) {
+      return SEAMCARVE_INVALID_TARGET;
+    }
+    if (output->format != input->format || output->width < input->width || output->height < input->height) {
+      return SEAMCARVE_OUTPUT_TOO_SMALL;
+    }
+
+    switch (input->format) {
+      case SEAMCARVE_RGB8: return carve<RGB8>(handle->context, input, output, targetWidth, targetHeight);
+      case SEAMCARVE_RGBA8: return carve<RGBA8>(handle->context, input, output, targetWidth, targetHeight);
+      case SEAMCARVE_GRAY8: return carve<Gray8>(handle->context, input, output, targetWidth, targetHeight);
+      case SEAMCARVE_RGB16: return carve<RGB16>(handle->context, input, output, targetWidth, targetHeight);
+    }
+    return SEAMCARVE_INVALID_ARGUMENT;
+  }
+  catch (const std::bad_alloc&) {
+    return SEAMCARVE_OUT_OF_MEMORY;
+  }
+  catch (...) {
+    return SEAMCARVE_INVALID_ARGUMENT;
+  }
+}
+
+SeamcarveStatus seamcarveCarve(SeamcarveHandle* handle, SeamcarveImage* image, int targetWidth, int targetHeight) {
+  return seamcarveCarveInto(handle, image, image, targetWidth, targetHeight);
+}
+
+const char* seamcarveStatusString(SeamcarveStatus status) {
+  switch (status) {
+    case SEAMCARVE_OK: return "ok";
+    case SEAMCARVE_INVALID_ARGUMENT: return "invalid argument";
+    case SEAMCARVE_INVALID_TARGET: return "target size is bigger than the image or under 1 pixel";
+    case SEAMCARVE_INVALID_STRIDE: return "stride is not a multiple of the pixel size or shorter than a row";
+    case SEAMCARVE_OUTPUT_TOO_SMALL: return "output buffer is smaller than the input or of another format";
+    case SEAMCARVE_OUT_OF_MEMORY: return "out of memory";
+  }
+  return "unknown status";
+}
@@ -0,0 +1,77 @@
+#ifndef SEAMCARVE_H
+#define SEAMCARVE_H
+
+/*
+seam carving as a library, for programs that already hold decoded pixels. Plain C, so it can
+be called from C, C++ or anything with a C FFI. The caller owns every pixel buffer: images are
+carved where they are, or into a buffer the caller passes in, and the library never copies
+them anywhere else. The only memory it allocates is the energy and cost tables, kept in the
+handle between calls.
+
+static:  g++ -std=c++17 -O2 -pthread -c functions.cpp instrument.cpp pixelformat.cpp seamcarve.cpp
+         ar rcs libseamcarve.a functions.o instrument.o pixelformat.o seamcarve.o
+shared:  g++ -std=c++17 -O2 -pthread -fPIC -shared functions.cpp instrument.cpp pixelformat.cpp seamcarve.cpp -o libseamcarve.so
+link:    gcc app.c -L. -lseamcarve -lstdc++ -lpthread (static), or gcc app.c -L. -lseamcarve (shared)
+*/
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  SEAMCARVE_RGB8,   // 3 bytes a pixel: r, g, b
+  SEAMCARVE_RGBA8,  // 4 bytes a pixel: r, g, b, a; alpha is carried along but has no energy
+  SEAMCARVE_GRAY8,  // 1 byte a pixel
+  SEAMCARVE_RGB16   // 6 bytes a pixel: r, g, b as native-endian 16-bit samples
+} SeamcarveFormat;
+
+typedef enum {
+  SEAMCARVE_OK = 0,
+  SEAMCARVE_INVALID_ARGUMENT,  // a null pointer, a size under 1 or an unknown format
+  SEAMCARVE_INVALID_TARGET,    // the target is bigger than the image or under 1 pixel
+  SEAMCARVE_INVALID_STRIDE,    // stride not a multiple of the pixel size, under a row, or pixels misaligned
+  SEAMCARVE_OUTPUT_TOO_SMALL,  // output buffer smaller than the input image, or of another format
+  SEAMCARVE_OUT_OF_MEMORY
+} SeamcarveStatus;
+
+// a caller-owned image: row r starts stride bytes after row r - 1. stride must be a multiple
+// of the pixel size (so a 3 byte format can't have rows padded to 4 bytes), and for RGB16 the
+// pixels must be 2-byte aligned
+typedef struct {
+  void* pixels;
+  int width;
+  int height;
+  ptrdiff_t stride;
+  SeamcarveFormat format;
+} SeamcarveImage;
+
+// working memory of the carves made with it (see CarveContext); one per thread, a handle must
+// not be used by two calls at once
+typedef struct SeamcarveHandle SeamcarveHandle;
+
+SeamcarveHandle* seamcarveCreate(void);  // null if out of memory
+void seamcarveDestroy(SeamcarveHandle* handle);
+
+// threads the carves may use, process-wide; 0 = one per core (the default)
+void seamcarveSetThreads(int threads);
+
+// carve image in place down to targetWidth x targetHeight, vertical seams first: the result
+// is the top-left corner of the buffer, and image->width/height are set to the target
+SeamcarveStatus seamcarveCarve(SeamcarveHandle* handle, SeamcarveImage* image, int targetWidth, int targetHeight);
+
+// the same carve with input left untouched. output describes the caller's buffer, of input's
+// format and at least input's width and height (the carve works in it, it is read from input
+// only once); on success the result is its top-left corner and output->width/height are set
+// to the target. The two buffers must not overlap
+SeamcarveStatus seamcarveCarveInto(SeamcarveHandle* handle, const SeamcarveImage* input, SeamcarveImage* output,
+                                   int targetWidth, int targetHeight);
+
+const char* seamcarveStatusString(SeamcarveStatus status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,85 +1,504 @@
-#include <iostream>
-#include <string>
-#include <sstream>
-#include <fstream>
-#include <cmath>
-#include "functions.h"
-
-using namespace std;
-
-int main() {
-  string filename;
-  int width = 0;
-  int height = 0;
-  int targetWidth = 0;
-  int targetHeight = 0;
-  
-  // Add code to validate input (Do in part 1)
-  cout << "Input filename: ";
-  cin >> filename;
-
-  cout << "Input width and height: ";
-  cin >> width;
-  if(cin.fail()){
-    cout << "Error: width is a non-integer value" << endl;
-    exit(-1);
-  }
-  if(width <= 0){
-    cout << "Error: width must be greater than 0. You entered " << width << endl;
-    exit(-1);
-  }
-
-  cin >> height;
-  if(cin.fail()){
-    cout << "Error: height is a non-integer value";
-    exit(-1);
-  }
-  if(height <= 0){
-    cout << "Error: height must be greater than 0. You entered " << height << endl;
-    exit(-1);
-  }
-
-  cout << "Input target width and target height: ";
-  cin >> targetWidth;
-  if(cin.fail()){
-    cout << "Error: target width is a non-integer value" << endl;
-    exit(-1);
-  }
-  if(targetWidth <= 0){
-    cout << "Error: target width must be greater than 0. You entered " << targetWidth << endl;
-    exit(-1);
-  }
-
-  cin >> targetHeight;
-  if(cin.fail()){
-    cout << "Error: target height is a non-integer value" << endl;
-    exit(-1);
-  }
-  if(targetHeight <= 0){
-    cout << "Error: target height must be greater than 0. You entered " << targetHeight << endl;
-    exit(-1);
-  }
-  
-  ifstream fin;
-
-  int originalWidth = width; // need to delete image array at end of program
-
-  Pixel** image = createImage(width, height); // create array of size that we need
-  if (image != nullptr) {
-    if (loadImage(filename, image, width, height)) {
-      cout << "Start carving..." << endl;
-      
-      // Add code to remove seams from image (Do in part 2)
-
-      // set up output filename
-      stringstream ss;
-      ss << "carved" << width << "X" << height << "." << filename;
-      outputImage(ss.str().c_str(), image, width, height);
-    }
-  
-    // call last to remove the memory from the heap
-    deleteImage(image, originalWidth);
-  }
-  // else 
-  
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+#include "functions.h"
+#include "batch.h"
+#include "removalindex.h"
+#include "streamcarve.h"
+#include "pixelformat.h"
+#include "energypolicy.h"
+#include "lazyimage.h"
+#include "sequence.h"
+#include "deadline.h"
+#include "resultcache.h"
+#include "instrument.h"
+
+using namespace std;
+
+static void printStats(const string& strategy, const RetargetStats& stats) {
+  cout << strategy << " order: " << stats.verticalSeams << " vertical and " << stats.horizontalSeams
+       << " horizontal seams, energy removed " << stats.energyRemoved << ", " << stats.seconds << " s" << endl;
+}
+
+static void printDeadline(const DeadlineStats& stats) {
+  cout << "Deadline " << stats.budget << " s: took " << stats.seconds << " s, went down to " << strategyName(stats.strategy)
+       << ", " << 100.0 * stats.exactShare << "% exact (";
+  for (int strategy = 0; strategy < STRATEGY_COUNT; ++strategy) {
+    cout << (strategy > 0 ? ", " : "") << stats.removed[strategy] << " " << strategyName(static_cast<CarveStrategy>(strategy));
+  }
+  cout << ")" << endl;
+}
+
+//phase timings and counters of the whole run, only when built with -DSEAM_PROFILE
+static void reportProfile(const string& label, const string& profilePath, const string& tracePath) {
+  if (!profileEnabled()) {
+    return;
+  }
+  profilePrintSummary(label);
+  if (!profilePath.empty()) {
+    profileWriteJson(profilePath, label);
+  }
+  if (!tracePath.empty()) {
+    profileWriteTrace(tracePath);
+  }
+}
+
+//carve filename once and save the order its pixels were removed in to filename.seams
+static bool buildIndex(const string& filename, int minimumWidth, int minimumHeight) {
+  int width, height;
+  if (!loadImageHeader(filename, width, height)) {
+    return false;
+  }
+  Image* image = createImage(width, height);
+  if (image == nullptr || !loadImage(filename, image)) {
+    deleteImage(image);
+    return false;
+  }
+  RemovalIndex* index = createRemovalIndex(image, minimumWidth, minimumHeight);
+  deleteImage(image);
+  if (index == nullptr) {
+    cout << "Error: not enough memory to index " << filename << endl;
+    return false;
+  }
+  bool ok = saveRemovalIndex(filename + ".seams", index);
+  if (ok) {
+    cout << "Indexed " << filename << ": widths " << width - index->columnsRemoved << "-" << width
+         << ", heights " << height - index->rowsRemoved << "-" << height << endl;
+  }
+  deleteRemovalIndex(index);
+  return ok;
+}
+
+//retarget filename through filename.seams, no seams are searched
+static bool applyIndex(const string& filename, int targetWidth, int targetHeight, const string& output, PpmFormat format) {
+  RemovalIndex* index = loadRemovalIndex(filename + ".seams");
+  if (index == nullptr) {
+    return false;
+  }
+  Image* image = createImage(index->width, index->height);
+  Image* carved = createImage(index->width, index->height);
+  bool ok = image != nullptr && carved != nullptr && loadImage(filename, image)
+            && applyRemovalIndex(image, index, targetWidth, targetHeight, carved)
+            && outputImage(output, carved, format);
+  deleteImage(carved);
+  deleteImage(image);
+  deleteRemovalIndex(index);
+  return ok;
+}
+
+//carve in a compact pixel format: vertical seams, then horizontal ones, one at a time
+template <class T>
+static bool carveCompact(Image* image, int targetWidth, int targetHeight, SeamMode search) {
+  BasicImage<T>* compact = convertImage<T>(image);
+  if (compact == nullptr) {
+    cout << "Error: not enough memory for a " << PixelFormat<T>::name() << " copy" << endl;
+    return false;
+  }
+  int columns = carveVerticalSeams(compact, targetWidth, search);
+  int rows = carveHorizontalSeams(compact, targetHeight, search);
+  convertImage(compact, image);
+  deleteBasicImage(compact);
+  cout << PixelFormat<T>::name() << ": " << columns << " vertical and " << rows << " horizontal seams" << endl;
+  return true;
+}
+
+//carve with an energy policy other than the default: vertical seams, then horizontal ones
+template <class Energy>
+static void carvePolicy(Image* image, int targetWidth, int targetHeight, SeamMode search) {
+  CarveContext* context = createCarveContext();
+  int columns = carveVerticalSeams<Energy>(image, targetWidth, context, search);
+  int rows = carveHorizontalSeams<Energy>(image, targetHeight, context, search);
+  deleteCarveContext(context);
+  cout << Energy::name() << " energy: " << columns << " vertical and " << rows << " horizontal seams" << endl;
+}
+
+int main(int argc, char* argv[]) {
+  // seams removed per pass, 1 = one at a time, 0 = picked by adaptiveSeamsPerPass
+  int seamsPerPass = 1;
+  // output encoding, --p6 forces binary, otherwise picked from the output name
+  PpmFormat outputFormat = PPM_AUTO;
+  // greedy, optimal, or compare (run both, keep the optimal result)
+  string order = "greedy";
+  // seam search for one-at-a-time carving, --pyramid LEVELS BAND switches to SEAM_PYRAMID
+  SeamMode search = SEAM_DP;
+  // batch mode: a manifest, or a directory plus target size and output directory
+  string manifest;
+  vector<string> batchDirectory;
+  int workers = 0;
+  long long memoryMB = 4096;
+  // profile summary as JSON and Chrome trace events, need a -DSEAM_PROFILE build
+  string profilePath;
+  string tracePath;
+  // seam index: build one next to an image, or retarget through an existing one
+  vector<string> indexBuild;
+  vector<string> indexApply;
+  // out-of-core carve of a P6 file: input, target width, target height, output
+  vector<string> stream;
+  // carve in a compact pixel format instead of int Pixels: rgb8, rgba8, gray8 or rgb16
+  string pixelFormat;
+  // energy metric: dual (the default), sobel, forward or luminance
+  string energyPolicy = "dual";
+  // remove seams through per-row live-column maps and compact the pixels once per direction
+  bool lazy = false;
+  // time budget in seconds, past which the carve falls back to cheaper strategies; < 0 = none
+  double deadline = -1.0;
+  // result cache: memory tier in MB, directory of the disk tier, and whether batches also keep
+  // each input's energy map to start carves to other targets from
+  CacheOptions cacheOptions = { 0, "", false };
+  string pyramidSettings = "off";
+  // frame sequence: input pattern, target width, target height, output pattern, plus the
+  // band searched around the previous frame's seams and the difference that counts as a cut
+  vector<string> sequence;
+  int band = 8;
+  double sceneCut = 0.3;
+  for (int i = 1; i < argc; ++i) {
+    string option = argv[i];
+    if (option == "--seams-per-pass" && i + 1 < argc) {
+      seamsPerPass = atoi(argv[++i]);
+    }
+    else if (option == "--p6") {
+      outputFormat = PPM_BINARY;
+    }
+    else if (option == "--order" && i + 1 < argc && (string(argv[i + 1]) == "greedy" || string(argv[i + 1]) == "optimal" || string(argv[i + 1]) == "compare")) {
+      order = argv[++i];
+    }
+    else if (option == "--threads" && i + 1 < argc) {
+      setThreadCount(atoi(argv[++i]));
+    }
+    else if (option == "--pyramid" && i + 2 < argc) {
+      setPyramid(atoi(argv[i + 1]), atoi(argv[i + 2]));
+      search = SEAM_PYRAMID;
+      pyramidSettings = string(argv[i + 1]) + "," + argv[i + 2];
+      i += 2;
+    }
+    else if (option == "--format" && i + 1 < argc && (string(argv[i + 1]) == "rgb8" || string(argv[i + 1]) == "rgba8"
+                                                      || string(argv[i + 1]) == "gray8" || string(argv[i + 1]) == "rgb16")) {
+      pixelFormat = argv[++i];
+    }
+    else if (option == "--energy" && i + 1 < argc && (string(argv[i + 1]) == "dual" || string(argv[i + 1]) == "sobel"
+                                                      || string(argv[i + 1]) == "forward" || string(argv[i + 1]) == "luminance")) {
+      energyPolicy = argv[++i];
+    }
+    else if (option == "--lazy") {
+      lazy = true;
+    }
+    else if (option == "--deadline" && i + 1 < argc) {
+      deadline = atof(argv[++i]);
+    }
+    else if (option == "--cache" && i + 1 < argc) {
+      cacheOptions.memoryMB = atoll(argv[++i]);
+    }
+    else if (option == "--cache-dir" && i + 1 < argc) {
+      cacheOptions.directory = argv[++i];
+    }
+    else if (option == "--cache-energy") {
+      cacheOptions.energies = true;
+    }
+    else if (option == "--batch" && i + 1 < argc) {
+      manifest = argv[++i];
+    }
+    else if (option == "--batch-dir" && i + 4 < argc) {
+      batchDirectory.assign(argv + i + 1, argv + i + 5);
+      i += 4;
+    }
+    else if (option == "--workers" && i + 1 < argc) {
+      workers = atoi(argv[++i]);
+    }
+    else if (option == "--memory" && i + 1 < argc) {
+      memoryMB = atoll(argv[++i]);
+    }
+    else if (option == "--index-build" && i + 3 < argc) {
+      indexBuild.assign(argv + i + 1, argv + i + 4);
+      i += 3;
+    }
+    else if (option == "--index-apply" && i + 4 < argc) {
+      indexApply.assign(argv + i + 1, argv + i + 5);
+      i += 4;
+    }
+    else if (option == "--sequence" && i + 4 < argc) {
+      sequence.assign(argv + i + 1, argv + i + 5);
+      i += 4;
+    }
+    else if (option == "--band" && i + 1 < argc) {
+      band = atoi(argv[++i]);
+    }
+    else if (option == "--scene-cut" && i + 1 < argc) {
+      sceneCut = atof(argv[++i]);
+    }
+    else if (option == "--stream" && i + 4 < argc) {
+      stream.assign(argv + i + 1, argv + i + 5);
+      i += 4;
+    }
+    else if ((option == "--profile" || option == "--trace") && i + 1 < argc) {
+      if (!profileEnabled()) {
+        cout << "Error: " << option << " needs a build with -DSEAM_PROFILE" << endl;
+        exit(-1);
+      }
+      (option == "--profile" ? profilePath : tracePath) = argv[++i];
+    }
+    else {
+      cout << "Usage: " << argv[0] << " [--seams-per-pass K] [--order greedy|optimal|compare] [--p6] [--threads N] [--pyramid LEVELS BAND]" << endl;
+      cout << "       " << string(string(argv[0]).size(), ' ') << " [--format rgb8|rgba8|gray8|rgb16] [--energy dual|sobel|forward|luminance] [--lazy]" << endl;
+      cout << "       " << string(string(argv[0]).size(), ' ') << " [--deadline SECONDS] [--cache MB] [--cache-dir DIR] [--cache-energy]" << endl;
+      cout << "       " << string(string(argv[0]).size(), ' ') << " [--profile FILE] [--trace FILE]" << endl;
+      cout << "       " << argv[0] << " --batch MANIFEST [--workers N] [--memory MB] [options]" << endl;
+      cout << "       " << argv[0] << " --batch-dir DIR WIDTH[%] HEIGHT[%] OUTDIR [--workers N] [--memory MB] [options]" << endl;
+      cout << "       " << argv[0] << " --index-build IMAGE MIN_WIDTH MIN_HEIGHT" << endl;
+      cout << "       " << argv[0] << " --index-apply IMAGE WIDTH HEIGHT OUTPUT [--p6]" << endl;
+      cout << "       " << argv[0] << " --stream INPUT.pnm WIDTH HEIGHT OUTPUT.pnm" << endl;
+      cout << "       " << argv[0] << " --sequence INPUT%04d.ppm WIDTH HEIGHT OUTPUT%04d.ppm [--band N] [--scene-cut FRACTION] [--p6]" << endl;
+      exit(-1);
+    }
+  }
+
+  // the carving modes are alternatives and only the first one given would run, so a second
+  // one is an error rather than something to drop without a word
+  vector<string> modes;
+  if (seamsPerPass != 1) {
+    modes.push_back("--seams-per-pass");
+  }
+  if (order != "greedy") {
+    modes.push_back("--order " + order);
+  }
+  if (!pixelFormat.empty()) {
+    modes.push_back("--format");
+  }
+  if (energyPolicy != "dual") {
+    modes.push_back("--energy");
+  }
+  if (lazy) {
+    modes.push_back("--lazy");
+  }
+  if (deadline >= 0) {
+    modes.push_back("--deadline");
+  }
+  if (modes.size() > 1) {
+    cout << "Error: " << modes[0] << " and " << modes[1] << " can't be used together" << endl;
+    exit(-1);
+  }
+  if (search == SEAM_PYRAMID && (deadline >= 0 || order == "optimal")) {
+    cout << "Error: --pyramid can't be used with " << modes[0] << ", which picks its own seam search" << endl;
+    exit(-1);
+  }
+  // batches carve with int Pixels and the dual-gradient energy, greedy or optimal
+  bool batch = !manifest.empty() || !batchDirectory.empty();
+  if (batch && !modes.empty() && modes[0] != "--seams-per-pass" && modes[0] != "--order optimal") {
+    cout << "Error: " << modes[0] << " isn't supported in batch mode" << endl;
+    exit(-1);
+  }
+
+  profileReset();
+  if (!indexBuild.empty()) {
+    bool ok = buildIndex(indexBuild[0], atoi(indexBuild[1].c_str()), atoi(indexBuild[2].c_str()));
+    reportProfile(indexBuild[0], profilePath, tracePath);
+    return ok ? 0 : 1;
+  }
+  if (!stream.empty()) {
+    bool ok = streamCarve(stream[0], atoi(stream[1].c_str()), atoi(stream[2].c_str()), stream[3]);
+    reportProfile(stream[0], profilePath, tracePath);
+    return ok ? 0 : 1;
+  }
+  if (!sequence.empty()) {
+    SequenceOptions options = { band, sceneCut, outputFormat };
+    SequenceSummary summary = carveSequence(sequence[0], atoi(sequence[1].c_str()), atoi(sequence[2].c_str()), sequence[3], options);
+    reportProfile(sequence[0], profilePath, tracePath);
+    return summary.failed == 0 ? 0 : 1;
+  }
+  if (!indexApply.empty()) {
+    bool ok = applyIndex(indexApply[0], atoi(indexApply[1].c_str()), atoi(indexApply[2].c_str()), indexApply[3], outputFormat);
+    reportProfile(indexApply[0], profilePath, tracePath);
+    return ok ? 0 : 1;
+  }
+  // everything besides the pixels and sizes that changes what a carve produces
+  stringstream carveParameters;
+  carveParameters << "order=" << order << " seams-per-pass=" << seamsPerPass << " pyramid=" << pyramidSettings << " energy=" << energyPolicy
+                  << " format=" << (pixelFormat.empty() ? "int" : pixelFormat) << " lazy=" << lazy;
+  ResultCache* cache = nullptr;
+  if (cacheOptions.memoryMB > 0 || !cacheOptions.directory.empty()) {
+    cache = createResultCache(cacheOptions);
+    if (cache == nullptr) {
+      exit(-1);
+    }
+  }
+  if (batch) {
+    vector<BatchJob> jobs;
+    bool listed = manifest.empty()
+      ? listDirectory(batchDirectory[0], batchDirectory[1], batchDirectory[2], batchDirectory[3], jobs)
+      : readManifest(manifest, jobs);
+    if (!listed) {
+      exit(-1);
+    }
+    BatchOptions options = { workers, memoryMB, seamsPerPass, order == "optimal" ? ORDER_OPTIMAL : ORDER_GREEDY, search, outputFormat,
+                             cache, carveParameters.str() };
+    BatchSummary summary = runBatch(jobs, options);
+    if (cache != nullptr) {
+      printCacheStats(cache);
+      deleteResultCache(cache);
+    }
+    reportProfile(manifest.empty() ? batchDirectory[0] : manifest, profilePath, tracePath);
+    return summary.failed == 0 ? 0 : 1;
+  }
+
+  string filename;
+  int width = 0;
+  int height = 0;
+  int targetWidth = 0;
+  int targetHeight = 0;
+  
+  // Add code to validate input (Do in part 1)
+  cout << "Input filename: ";
+  cin >> filename;
+
+  cout << "Input width and height: ";
+  cin >> width;
+  if(cin.fail()){
+    cout << "Error: width is a non-integer value" << endl;
+    exit(-1);
+  }
+  if(width <= 0){
+    cout << "Error: width must be greater than 0. You entered " << width << endl;
+    exit(-1);
+  }
+
+  cin >> height;
+  if(cin.fail()){
+    cout << "Error: height is a non-integer value";
+    exit(-1);
+  }
+  if(height <= 0){
+    cout << "Error: height must be greater than 0. You entered " << height << endl;
+    exit(-1);
+  }
+
+  cout << "Input target width and target height: ";
+  cin >> targetWidth;
+  if(cin.fail()){
+    cout << "Error: target width is a non-integer value" << endl;
+    exit(-1);
+  }
+  if(targetWidth <= 0){
+    cout << "Error: target width must be greater than 0. You entered " << targetWidth << endl;
+    exit(-1);
+  }
+  if(targetWidth > width){
+    cout << "Error: target width must be at most " << width << ". You entered " << targetWidth << endl;
+    exit(-1);
+  }
+
+  cin >> targetHeight;
+  if(cin.fail()){
+    cout << "Error: target height is a non-integer value" << endl;
+    exit(-1);
+  }
+  if(targetHeight <= 0){
+    cout << "Error: target height must be greater than 0. You entered " << targetHeight << endl;
+    exit(-1);
+  }
+  if(targetHeight > height){
+    cout << "Error: target height must be at most " << height << ". You entered " << targetHeight << endl;
+    exit(-1);
+  }
+  
+  // rgb16 keeps 16-bit samples all the way through, everything else works in 0-255
+  int maxval = pixelFormat == "rgb16" ? 65535 : 255;
+  Image* image = createImage(width, height); // create array of size that we need
+  if (image != nullptr) {
+    if (loadImage(filename, image, maxval)) {
+      cout << "Start carving..." << endl;
+
+      // deadline carves depend on timing and compare only prints, so neither is cached
+      string key;
+      bool cached = false;
+      if (cache != nullptr && deadline < 0 && order != "compare") {
+        key = cacheKey(hashImage(image), width, height, targetWidth, targetHeight, carveParameters.str());
+        cached = cacheLookup(cache, key, image);
+      }
+      
+      // Add code to remove seams from image (Do in part 2)
+      if (cached) {
+        cout << "Cache hit, carving skipped" << endl;
+      }
+      else if (!pixelFormat.empty()) {
+        bool carved = pixelFormat == "rgb8" ? carveCompact<RGB8>(image, targetWidth, targetHeight, search)
+                    : pixelFormat == "rgba8" ? carveCompact<RGBA8>(image, targetWidth, targetHeight, search)
+                    : pixelFormat == "gray8" ? carveCompact<Gray8>(image, targetWidth, targetHeight, search)
+                    : carveCompact<RGB16>(image, targetWidth, targetHeight, search);
+        if (!carved) {
+          deleteImage(image);
+          exit(-1);
+        }
+      }
+      else if (energyPolicy != "dual") {
+        if (energyPolicy == "sobel") {
+          carvePolicy<SobelEnergy>(image, targetWidth, targetHeight, search);
+        }
+        else if (energyPolicy == "forward") {
+          carvePolicy<ForwardEnergy>(image, targetWidth, targetHeight, search);
+        }
+        else {
+          carvePolicy<LuminanceEnergy>(image, targetWidth, targetHeight, search);
+        }
+      }
+      else if (deadline >= 0) {
+        printDeadline(carveWithDeadline(image, targetWidth, targetHeight, deadline));
+      }
+      else if (lazy) {
+        CarveContext* context = createCarveContext();
+        int removed = carveLazily(image, targetWidth, targetHeight, context, search);
+        deleteCarveContext(context);
+        cout << "Lazy removal: " << removed << " seams" << endl;
+      }
+      else if (seamsPerPass != 1) {
+        // batches only run in one direction at a time: all columns, then all rows
+        carveVerticalSeams(image, targetWidth, seamsPerPass, search);
+        carveHorizontalSeams(image, targetHeight, seamsPerPass, search);
+      }
+      else if (order == "compare") {
+        Image* greedy = createImage(width, height);
+        copyImage(image, greedy);
+        RetargetStats exact = retargetImage(greedy, targetWidth, targetHeight, ORDER_GREEDY);
+        printStats("Greedy", exact);
+        if (search == SEAM_PYRAMID) {
+          // same order with the pyramid search, measured against the exact greedy run
+          copyImage(image, greedy);
+          RetargetStats pyramid = retargetImage(greedy, targetWidth, targetHeight, ORDER_GREEDY, SEAM_PYRAMID);
+          printStats("Pyramid greedy", pyramid);
+          cout << "Pyramid energy vs exact: " << pyramid.energyRemoved - exact.energyRemoved << " ("
+               << (exact.energyRemoved > 0 ? 100.0 * (pyramid.energyRemoved - exact.energyRemoved) / exact.energyRemoved : 0.0) << "%)" << endl;
+        }
+        deleteImage(greedy);
+        printStats("Optimal", retargetImage(image, targetWidth, targetHeight, ORDER_OPTIMAL));
+      }
+      else if (order == "optimal") {
+        printStats("Optimal", retargetImage(image, targetWidth, targetHeight, ORDER_OPTIMAL));
+      }
+      else {
+        printStats(search == SEAM_PYRAMID ? "Pyramid greedy" : "Greedy", retargetImage(image, targetWidth, targetHeight, ORDER_GREEDY, search));
+      }
+
+      if (!key.empty() && !cached) {
+        cacheStore(cache, key, image);
+      }
+      if (cache != nullptr) {
+        printCacheStats(cache);
+      }
+
+      // set up output filename
+      stringstream ss;
+      ss << "carved" << image->width << "X" << image->height << "." << filename;
+      outputImage(ss.str().c_str(), image, outputFormat, maxval);
+      reportProfile(filename, profilePath, tracePath);
+    }
+  
+    // call last to remove the memory from the heap
+    deleteImage(image);
+  }
+  deleteResultCache(cache);
+  // else 
+  
 }
\ No newline at end of file
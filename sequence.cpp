@@ -0,0 +1,246 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include "sequence.h"
+#include "instrument.h"
+
+using namespace std;
+
+//scene changes are judged on a luma histogram of every 2nd pixel of every 2nd row: it
+//hardly moves when the camera pans or things move around, and jumps at a cut
+static const int SIGNATURE_STEP = 2;
+static const int SIGNATURE_BINS = 64;
+
+//exactly one %d, optionally with a width (%04d), and no other conversion; %% is a literal %
+static bool validFramePattern(const string& pattern) {
+  int numbers = 0;
+  for (size_t i = 0; i < pattern.size(); ++i) {
+    if (pattern[i] != '%') {
+      continue;
+    }
+    if (i + 1 < pattern.size() && pattern[i + 1] == '%') {
+      ++i;
+      continue;
+    }
+    size_t j = i + 1;
+    while (j < pattern.size() && isdigit(static_cast<unsigned char>(pattern[j]))) {
+      ++j;
+    }
+    if (j == pattern.size() || pattern[j] != 'd') {
+      return false;
+    }
+    ++numbers;
+    i = j;
+  }
+  return numbers == 1;
+}
+
+static string frameName(const string& pattern, int number) {
+  vector<char> name(pattern.size() + 32);
+  snprintf(name.data(), name.size(), pattern.c_str(), number);
+  return name.data();
+}
+
+static bool frameExists(const string& name) {
+  return ifstream(name).is_open();
+}
+
+//histogram of the sampled luma, (77 r + 150 g + 29 b) / 256, of the frame as loaded
+static void frameSignature(const Image* image, vector<int>& signature) {
+  signature.assign(SIGNATURE_BINS, 0);
+  for (int row = 0; row < image->height; row += SIGNATURE_STEP) {
+    const Pixel* line = imageRow(image, row);
+    for (int col = 0; col < image->width; col += SIGNATURE_STEP) {
+      int luma = (77 * line[col].r + 150 * line[col].g + 29 * line[col].b) >> 8;
+      ++signature[min(SIGNATURE_BINS - 1, max(0, luma * SIGNATURE_BINS / 256))];
+    }
+  }
+}
+
+//share of the sampled pixels that would have to change bins to turn one histogram into the
+//other, 0 to 1; -1 if there is no previous frame to compare with
+static double signatureDifference(const vector<int>& a, const vector<int>& b) {
+  if (a.size() != b.size()) {
+    return -1.0;
+  }
+  long long total = 0;
+  long long samples = 0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    total += abs(a[i] - b[i]);
+    samples += a[i];
+  }
+  return samples > 0 ? static_cast<double>(total) / (2 * samples) : 0.0;
+}
+
+//the vertical seams one direction of a frame removed, in order; seam k is in the columns of
+//the image with the k seams before it gone, which is where the next frame's seam k is searched
+struct SeamHistory {
+  int width;           // size of the image the seams were removed from
+  int height;
+  vector<int> seams;   // [k * height + row]
+};
+
+//remove vertical seams from image down to targetWidth. Within a scene, seam k is searched in
+//a band around history's seam k (band 0 searches everything but still measures the movement);
+//history then holds this frame's seams. Returns false if the energy map couldn't be allocated
+static bool carveFrame(Image* image, int targetWidth, bool sameScene, int band, CarveContext* context,
+                       SeamHistory& history, long long& shift, long long& rows) {
+  int count = image->width - targetWidth;
+  int height = image->height;
+  bool comparable = sameScene && count > 0 && history.width == image->width && history.height == height
+                    && history.seams.size() == static_cast<size_t>(count) * height;
+  bool seeded = comparable && band > 0;
+  history.width = image->width;
+  history.height = height;
+  history.seams.resize(static_cast<size_t>(max(0, count)) * height);
+  if (count <= 0) {
+    return true;
+  }
+
+  EnergyMap* energies = createEnergyMap(image);
+  if (energies == nullptr) {
+    history.seams.clear();
+    return false;
+  }
+  vector<int> seam(height);
+  for (int k = 0; k < count; ++k) {
+    int* previous = &history.seams[static_cast<size_t>(k) * height];
+    if (seeded) {
+      traceBandedVerticalSeam(energies, previous, band, seam.data(), context);
+    }
+    else {
+      traceMinVerticalSeam(energies, seam.data(), SEAM_DP, context);
+    }
+    if (comparable) {
+      for (int row = 0; row < height; ++row) {
+        shift += abs(seam[row] - previous[row]);
+      }
+      rows += height;
+    }
+    copy(seam.begin(), seam.end(), previous);
+    removeVerticalSeam(image, seam.data(), energies);
+    if (!seeded && k + 1 < count) {
+      updateVerticalCost(energies, seam.data(), context);
+    }
+  }
+  deleteEnergyMap(energies);
+  return true;
+}
+
+SequenceSummary carveSequence(string inputPattern, int targetWidth, int targetHeight, string outputPattern, const SequenceOptions& options) {
+  SequenceSummary summary = { 0, 0, 0, 0.0, 0.0, 0.0 };
+  if (!validFramePattern(inputPattern) || !validFramePattern(outputPattern)) {
+    cout << "Error: frame patterns need exactly one %d (or %04d etc.) for the frame number" << endl;
+    summary.failed = 1;
+    return summary;
+  }
+  int number = frameExists(frameName(inputPattern, 0)) ? 0 : 1;
+  if (!frameExists(frameName(inputPattern, number))) {
+    cout << "Error: no frame 0 or 1 - " << frameName(inputPattern, 1) << endl;
+    summary.failed = 1;
+    return summary;
+  }
+
+  setVerbose(false);
+  CarveContext* context = createCarveContext();
+  Image* image = nullptr;
+  int width = 0;
+  int height = 0;
+  int previousWidth = 0;
+  int previousHeight = 0;
+  vector<int> signature;
+  vector<int> previousSignature;
+  SeamHistory columns = { 0, 0, {} };
+  SeamHistory rows = { 0, 0, {} };
+  long long shift = 0;
+  long long shiftedRows = 0;
+  auto start = chrono::steady_clock::now();
+
+  for (; frameExists(frameName(inputPattern, number)); ++number) {
+    string input = frameName(inputPattern, number);
+    string output = frameName(outputPattern, number);
+    PROFILE_TASK(input);
+    auto frameStart = chrono::steady_clock::now();
+    cout << "[" << number << "] " << input << " -> " << output;
+
+    int frameWidth = 0, frameHeight = 0;
+    if (!loadImageHeader(input, frameWidth, frameHeight) || frameWidth < targetWidth || frameHeight < targetHeight) {
+      cout << ": FAILED (" << (frameWidth > 0 ? "target is bigger than the frame" : "bad header") << ")" << endl;
+      ++summary.failed;
+      previousSignature.clear();
+      continue;
+    }
+    //the image is reused while the frames keep their size, carving only narrows its view
+    if (image == nullptr || frameWidth != width || frameHeight != height) {
+      deleteImage(image);
+      image = createImage(frameWidth, frameHeight);
+      width = frameWidth;
+      height = frameHeight;
+    }
+    if (image != nullptr) {
+      image->width = width;
+      image->height = height;
+    }
+    if (image == nullptr || !loadImage(input, image)) {
+      cout << ": FAILED (load)" << endl;
+      ++summary.failed;
+      previousSignature.clear();
+      continue;
+    }
+
+    //a frame of another size never continues the scene
+    if (width != previousWidth || height != previousHeight) {
+      previousSignature.clear();
+    }
+    previousWidth = width;
+    previousHeight = height;
+    frameSignature(image, signature);
+    double difference = signatureDifference(signature, previousSignature);
+    bool sameScene = difference >= 0 && difference <= options.sceneCut;
+    signature.swap(previousSignature);
+
+    bool carved = carveFrame(image, targetWidth, sameScene, options.band, context, columns, shift, shiftedRows);
+    if (carved && image->height > targetHeight) {
+      Image* transposed = createImage(image->height, image->width);
+      carved = transposed != nullptr;
+      if (carved) {
+        transposeImage(image, transposed);
+        carved = carveFrame(transposed, targetHeight, sameScene, options.band, context, rows, shift, shiftedRows);
+        transposeImage(transposed, image);
+      }
+      deleteImage(transposed);
+    }
+    if (!carved || !outputImage(output, image, options.format)) {
+      cout << ": FAILED (" << (carved ? "write" : "out of memory") << ")" << endl;
+      ++summary.failed;
+      previousSignature.clear();
+      continue;
+    }
+
+    ++summary.frames;
+    if (!sameScene || options.band <= 0) {
+      ++summary.fullSearches;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - frameStart).count();
+    cout << ": " << (sameScene ? (options.band > 0 ? "banded" : "full") : (difference < 0 ? "full (no previous frame of this size)" : "full (scene change)"))
+         << " (" << seconds << " s)" << endl;
+  }
+
+  deleteImage(image);
+  deleteCarveContext(context);
+  setVerbose(true);
+
+  summary.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  summary.framesPerSecond = summary.seconds > 0 ? summary.frames / summary.seconds : 0.0;
+  summary.seamShift = shiftedRows > 0 ? static_cast<double>(shift) / shiftedRows : 0.0;
+  cout << "Carved " << summary.frames << " frames (" << summary.failed << " failed) in " << summary.seconds << " s, "
+       << summary.framesPerSecond << " frames/s; " << summary.fullSearches << " full searches, seams moved "
+       << summary.seamShift << " columns a row between frames" << endl;
+  return summary;
+}
@@ -0,0 +1,34 @@
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#include <string>
+#include "functions.h"
+
+// frame sequences, e.g. video exported as frame0001.ppm, frame0002.ppm, ... Each frame is
+// carved to the same size, vertical seams first, then horizontal ones. Within a scene the k-th
+// seam of a frame is searched only within band columns of the k-th seam of the frame before,
+// which is much cheaper than a full search and keeps seams from jumping around between frames.
+// The first frame, a frame whose size changed and a frame whose luma histogram differs from the
+// previous frame's by more than sceneCut get the full search instead.
+struct SequenceOptions {
+  int band;          // columns searched either side of the previous seam, 0 = full search every frame
+  double sceneCut;   // share of pixels changing histogram bins (0-1) that starts a new scene
+  PpmFormat format;  // output encoding
+};
+
+struct SequenceSummary {
+  int frames;           // frames carved and written
+  int failed;
+  int fullSearches;     // frames searched from scratch: the first and every scene change
+  double seconds;
+  double framesPerSecond;
+  double seamShift;     // mean columns a seam row moved from one frame to the next within a scene
+};
+
+// patterns hold one printf-style frame number, %d or e.g. %04d, and %% for a literal %.
+// Frames are read from number 0 (or 1 if there is no frame 0) until the next number has no
+// file, and each one is written to outputPattern with the same number
+SequenceSummary carveSequence(std::string inputPattern, int targetWidth, int targetHeight,
+                              std::string outputPattern, const SequenceOptions& options);
+
+#endif
@@ -0,0 +1,426 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "functions.h"
+#include "streamcarve.h"
+
+using namespace std;
+
+//how much of a mapping a pass touches before handing it back
+static const size_t STREAM_STRIP_BYTES = 32 << 20;
+
+//a file mapped read-write and shared, so everything written to the mapping ends up in the file
+class BackingFile {
+ public:
+  BackingFile() : fd(-1), data(nullptr), size(0) {}
+
+  BackingFile(const BackingFile&) = delete;
+  BackingFile& operator=(const BackingFile&) = delete;
+
+  ~BackingFile() {
+    unmap();
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  //create (or truncate) path at size bytes and map it
+  bool create(const string& path, size_t bytes) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    return fd >= 0 && map(bytes);
+  }
+
+  //a new scratch file of size bytes in the directory of nextTo, under a name mkstemp makes
+  //up so no existing file is touched; unlinked right away so it disappears with the
+  //process, whatever happens
+  bool createScratch(const string& nextTo, size_t bytes) {
+    string name = nextTo + ".XXXXXX";
+    vector<char> path(name.begin(), name.end());
+    path.push_back('\0');
+    fd = mkstemp(path.data());
+    if (fd < 0) {
+      return false;
+    }
+    unlink(path.data());
+    return map(bytes);
+  }
+
+  //unmap and cut the file down to its first bytes
+  bool finish(size_t bytes) {
+    unmap();
+    return ftruncate(fd, static_cast<off_t>(bytes)) == 0;
+  }
+
+  //hand [begin, end) of the mapping back; the data stays in the file / page cache
+  void drop(size_t begin, size_t end) {
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    begin = begin / page * page;
+    end = min(size, (end + page - 1) / page * page);
+    if (data != nullptr && begin < end) {
+      madvise(data + begin, end - begin, MADV_DONTNEED);
+    }
+  }
+
+  int fd;
+  unsigned char* data;
+  size_t size;
+
+ private:
+  bool map(size_t bytes) {
+    if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+      return false;
+    }
+    void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+      return false;
+    }
+    data = static_cast<unsigned char*>(mapped);
+    size = bytes;
+    return true;
+  }
+
+  void unmap() {
+    if (data != nullptr) {
+      munmap(data, size);
+      data = nullptr;
+    }
+  }
+};
+
+//width x height RGB8 pixels inside a backing file, rowBytes apart
+struct StreamPlane {
+  BackingFile* file;
+  size_t offset;   // where row 0 starts in the file
+  size_t rowBytes;
+  int width;
+  int height;
+};
+
+static unsigned char* planeRow(const StreamPlane& plane, int row) {
+  return plane.file->data + plane.offset + plane.rowBytes * row;
+}
+
+static void dropRows(const StreamPlane& plane, int first, int last) {
+  plane.file->drop(plane.offset + plane.rowBytes * first, plane.offset + plane.rowBytes * last);
+}
+
+static int stripRows(size_t rowBytes) {
+  return static_cast<int>(max<size_t>(1, STREAM_STRIP_BYTES / max<size_t>(1, rowBytes)));
+}
+
+//P6 header: size, maxval and where the samples start; reads at most the first few KB
+static bool readStreamHeader(int fd, int& width, int& height, int& maxval, size_t& body) {
+  char header[4096];
+  ssize_t length = pread(fd, header, sizeof(header), 0);
+  if (length < 2 || header[0] != 'P' || header[1] != '6') {
+    cout << "Error: streaming needs a binary P6 file" << endl;
+    return false;
+  }
+  ssize_t at = 2;
+  int values[3];
+  for (int& value : values) {
+    //whitespace and # comments between fields
+    while (at < length && (isspace(static_cast<unsigned char>(header[at])) || header[at] == '#')) {
+      if (header[at] == '#') {
+        while (at < length && header[at] != '\n') {
+          ++at;
+        }
+      }
+      else {
+        ++at;
+      }
+    }
+    if (at >= length || !isdigit(static_cast<unsigned char>(header[at]))) {
+      cout << "Error: read non-integer value" << endl;
+      return false;
+    }
+    long long parsed = 0;
+    while (at < length && isdigit(static_cast<unsigned char>(header[at])) && parsed <= INT_MAX) {
+      parsed = parsed * 10 + (header[at++] - '0');
+    }
+    if (parsed <= 0 || parsed > INT_MAX) {
+      cout << "Error: invalid header value " << parsed << endl;
+      return false;
+    }
+    value = static_cast<int>(parsed);
+  }
+  if (at >= length || !isspace(static_cast<unsigned char>(header[at]))) {
+    cout << "Error: read non-integer value" << endl;
+    return false;
+  }
+  width = values[0];
+  height = values[1];
+  maxval = values[2];
+  body = static_cast<size_t>(at + 1);
+  if (maxval > 255) {
+    cout << "Error: streaming needs maxval below 256, the file has " << maxval << endl;
+    return false;
+  }
+  return true;
+}
+
+//read the samples into the plane a strip at a time, rescaling to 0-255
+static bool readStreamPixels(int fd, size_t body, int maxval, const StreamPlane& plane) {
+  unsigned char scale[256];
+  for (int value = 0; value < 256; ++value) {
+    scale[value] = static_cast<unsigned char>(min(255, (value * 255 + maxval / 2) / maxval));
+  }
+  int strip = stripRows(plane.rowBytes);
+  off_t position = static_cast<off_t>(body);
+  for (int first = 0; first < plane.height; first += strip) {
+    int last = min(plane.height, first + strip);
+    unsigned char* out = planeRow(plane, first);
+    size_t wanted = plane.rowBytes * (last - first);
+    size_t done = 0;
+    while (done < wanted) {
+      ssize_t got = pread(fd, out + done, wanted - done, position);
+      if (got <= 0) {
+        cout << "Error: not enough color values" << endl;
+        return false;
+      }
+      done += static_cast<size_t>(got);
+      position += got;
+    }
+    if (maxval != 255) {
+      for (size_t i = 0; i < wanted; ++i) {
+        if (out[i] > maxval) {
+          cout << "Error: invalid color value " << static_cast<int>(out[i]) << endl;
+          return false;
+        }
+        out[i] = scale[out[i]];
+      }
+    }
+    dropRows(plane, first, last);
+  }
+  return true;
+}
+
+//one row of the plane into a row of Pixels
+static void unpackRow(const unsigned char* in, int width, Pixel* out) {
+  for (int col = 0; col < width; ++col, in += 3) {
+    out[col] = { in[0], in[1], in[2] };
+  }
+}
+
+//remove exact seams from the plane until it is targetWidth wide. Each seam is one
+//bottom-up pass (energies from a 3 row window, one row of costs, a direction byte per
+//pixel), one top-down walk of the directions and one removal pass
+static bool carvePlane(StreamPlane& plane, int targetWidth, BackingFile& directions) {
+  int height = plane.height;
+  size_t directionStride = static_cast<size_t>(plane.width);
+  int pixelStrip = stripRows(plane.rowBytes);
+  int directionStrip = stripRows(directionStride);
+
+  //rows r-1, r and r+1 of the pixels, row r kept in slot r % 3 so computeEnergyRow
+  //finds its neighbours above and below it; fewer than 3 rows means no vertical gradient
+  Image* window = createImage(plane.width, 3);
+  if (window == nullptr) {
+    return false;
+  }
+  window->height = min(height, 3);
+  vector<long long> below(plane.width);
+  vector<long long> current(plane.width);
+  vector<int> energies(plane.width);
+  vector<int> seam(height);
+
+  while (plane.width > targetWidth) {
+    int width = plane.width;
+    window->width = width;
+    int loaded[3] = { -1, -1, -1 };
+    auto load = [&](int slot, int row) {
+      if (loaded[slot] != row) {
+        unpackRow(planeRow(plane, row), width, imageRow(window, slot));
+        loaded[slot] = row;
+      }
+    };
+
+    for (int row = height - 1; row >= 0; --row) {
+      int slot = row % 3;
+      load(slot, row);
+      if (height >= 3) {
+        load((slot + 2) % 3, (row - 1 + height) % height);
+        load((slot + 1) % 3, (row + 1) % height);
+      }
+      computeEnergyRow(window, slot, energies.data());
+
+      if (row == height - 1) {
+        for (int col = 0; col < width; ++col) {
+          current[col] = energies[col];
+        }
+      }
+      else {
+        //same preference as traceVerticalSeam: middle, then right, then left, ties stay put
+        unsigned char* step = directions.data + directionStride * row;
+        for (int col = 0; col < width; ++col) {
+          int next = col;
+          if (col < width - 1 && below[col + 1] < below[next]) {
+            next = col + 1;
+          }
+          if (col > 0 && below[col - 1] < below[next]) {
+            next = col - 1;
+          }
+          current[col] = energies[col] + below[next];
+          step[col] = static_cast<unsigned char>(next - col + 1);
+        }
+      }
+      swap(below, current);
+
+      if ((height - row) % pixelStrip == 0) {
+        dropRows(plane, row, min(height, row + pixelStrip));
+      }
+      if ((height - row) % directionStrip == 0) {
+        directions.drop(directionStride * row, directionStride * min(height, row + directionStrip));
+      }
+    }
+    dropRows(plane, 0, min(height, pixelStrip));
+
+    //leftmost cheapest start, then follow the directions down
+    int col = 0;
+    for (int i = 1; i < width; ++i) {
+      if (below[i] < below[col]) {
+        col = i;
+      }
+    }
+    for (int row = 0; row < height; ++row) {
+      seam[row] = col;
+      if (row < height - 1) {
+        col += directions.data[directionStride * row + col] - 1;
+      }
+    }
+    directions.drop(0, directions.size);
+
+    for (int first = 0; first < height; first += pixelStrip) {
+      int last = min(height, first + pixelStrip);
+      for (int row = first; row < last; ++row) {
+        unsigned char* line = planeRow(plane, row);
+        memmove(line + 3 * seam[row], line + 3 * (seam[row] + 1), 3 * static_cast<size_t>(width - seam[row] - 1));
+      }
+      dropRows(plane, first, last);
+    }
+    plane.width = width - 1;
+  }
+
+  deleteImage(window);
+  return true;
+}
+
+//destination(row, col) = source(col, row), in blocks of columns narrow enough that one
+//block of destination rows fits in a strip; source rows are handed back a strip at a time
+static void transposePlane(const StreamPlane& source, StreamPlane& destination) {
+  int block = static_cast<int>(min<size_t>(1024, max<size_t>(8, STREAM_STRIP_BYTES / max<size_t>(1, 3 * static_cast<size_t>(source.height)))));
+  int strip = stripRows(source.rowBytes);
+  for (int firstCol = 0; firstCol < source.width; firstCol += block) {
+    int lastCol = min(source.width, firstCol + block);
+    for (int row = 0; row < source.height; ++row) {
+      const unsigned char* in = planeRow(source, row) + 3 * static_cast<size_t>(firstCol);
+      for (int col = firstCol; col < lastCol; ++col, in += 3) {
+        memcpy(planeRow(destination, col) + 3 * static_cast<size_t>(row), in, 3);
+      }
+      if ((row + 1) % strip == 0 || row + 1 == source.height) {
+        dropRows(source, row + 1 - ((row % strip) + 1), row + 1);
+      }
+    }
+    dropRows(destination, firstCol, lastCol);
+  }
+  destination.width = source.height;
+  destination.height = source.width;
+}
+
+bool streamCarve(string input, int targetWidth, int targetHeight, string output) {
+  if (input == output) {
+    cout << "Error: streaming output must be a different file from the input" << endl;
+    return false;
+  }
+  int in = open(input.c_str(), O_RDONLY);
+  if (in < 0) {
+    cout << "Error: failed to open input file - " << input << endl;
+    return false;
+  }
+  int width, height, maxval;
+  size_t body;
+  if (!readStreamHeader(in, width, height, maxval, body)) {
+    close(in);
+    return false;
+  }
+  if (targetWidth <= 0 || targetWidth > width || targetHeight <= 0 || targetHeight > height) {
+    cout << "Error: target size must be between 1x1 and " << width << "x" << height << endl;
+    close(in);
+    return false;
+  }
+
+  //the output file is the backing store: header, then width x height RGB8 pixels that get
+  //carved in place and packed down to the final size at the end
+  string header = "P6\n" + to_string(width) + " " + to_string(height) + "\n255\n";
+  size_t pixelBytes = static_cast<size_t>(width) * height * 3;
+  BackingFile file;
+  BackingFile directions;
+  //once the output is open a failure leaves no half-written file behind
+  auto abandon = [&]() {
+    if (file.fd >= 0) {
+      unlink(output.c_str());
+    }
+    return false;
+  };
+  if (!file.create(output, header.size() + pixelBytes)) {
+    cout << "Error: failed to open output file - " << output << endl;
+    close(in);
+    return abandon();
+  }
+  if (!directions.createScratch(output, static_cast<size_t>(width) * height)) {
+    cout << "Error: failed to create scratch file next to " << output << endl;
+    close(in);
+    return abandon();
+  }
+
+  StreamPlane plane = { &file, header.size(), static_cast<size_t>(width) * 3, width, height };
+  bool ok = readStreamPixels(in, body, maxval, plane);
+  close(in);
+  if (!ok || !carvePlane(plane, targetWidth, directions)) {
+    return abandon();
+  }
+
+  //the final header is never longer than the first one, so the packed rows can be moved
+  //down from the front without overwriting anything still to be read
+  string finalHeader = "P6\n" + to_string(targetWidth) + " " + to_string(targetHeight) + "\n255\n";
+  StreamPlane packed = { &file, finalHeader.size(), static_cast<size_t>(targetWidth) * 3, targetWidth, targetHeight };
+
+  if (targetHeight == height) {
+    int strip = stripRows(plane.rowBytes);
+    for (int first = 0; first < height; first += strip) {
+      int last = min(height, first + strip);
+      for (int row = first; row < last; ++row) {
+        memmove(planeRow(packed, row), planeRow(plane, row), packed.rowBytes);
+      }
+      dropRows(plane, first, last);
+    }
+  }
+  else {
+    //rows are carved as the columns of a transposed copy in a scratch file
+    BackingFile transposedFile;
+    if (!transposedFile.createScratch(output, static_cast<size_t>(targetWidth) * height * 3)) {
+      cout << "Error: failed to create scratch file next to " << output << endl;
+      return abandon();
+    }
+    StreamPlane transposed = { &transposedFile, 0, static_cast<size_t>(height) * 3, height, targetWidth };
+    transposePlane(plane, transposed);
+    if (!carvePlane(transposed, targetHeight, directions)) {
+      return abandon();
+    }
+    transposePlane(transposed, packed);
+  }
+
+  memcpy(file.data, finalHeader.data(), finalHeader.size());
+  if (!file.finish(finalHeader.size() + packed.rowBytes * targetHeight)) {
+    cout << "Error: failed to write output file - " << output << endl;
+    return abandon();
+  }
+  return true;
+}
@@ -0,0 +1,21 @@
+#ifndef STREAMCARVE_H
+#define STREAMCARVE_H
+
+#include <string>
+
+// out-of-core carving for images that don't fit in memory. The pixels never become an
+// Image: they live in the output file, mapped as 3 bytes per pixel, and every pass
+// (energy + cumulative cost, seam backtracking, removal, transposes) streams through it
+// a strip of rows at a time, handing each strip back to the page cache once it is done.
+// Resident memory is a few rows of working space plus about one strip, whatever the size
+// of the image. The cost table is never stored: the DP keeps one row of costs and writes
+// one direction byte per pixel to a scratch file next to the output, which the backtrack
+// then follows from the top.
+//
+// input must be a binary P6 file with maxval below 256 (the output is always maxval 255).
+// The seams removed are the ones carveVerticalSeams and then carveHorizontalSeams would
+// remove from the loaded image, one exact seam at a time. A carve that fails part way
+// removes the output again.
+bool streamCarve(std::string input, int targetWidth, int targetHeight, std::string output);
+
+#endif
@@ -0,0 +1,293 @@
+// compile command:  g++ -std=c++17 -pthread -DSEAM_COUNT_ALLOCATIONS functions.cpp instrument.cpp tests.cpp -o tests
+// (without -DSEAM_COUNT_ALLOCATIONS the allocation check is skipped)
+// usage: ./tests, exits non-zero if any case fails
+
+/*
+- regression cases for malformed input that once loaded as a corrupted image instead of failing,
+  and for output that once went out of range
+- checks of promises the carving code makes: the same seams whatever the cost table reuse,
+  and no allocations once a context has warmed up, the same seams on any number of threads,
+  and the same energies from every instruction set
+- every case writes its file to the working directory, loads it, and removes it again
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <iterator>
+#include <cstdio>
+#include <algorithm>
+#include <csignal>
+#include <sys/resource.h>
+#include "functions.h"
+#include "instrument.h"
+
+using namespace std;
+
+static int failures = 0;
+
+//write contents to name and load it as a width x height image with samples in 0-range
+static bool loads(const string& name, const string& contents, int width, int height, int range = 255) {
+  {
+    ofstream file(name, ios::binary);
+    file << contents;
+  }
+  Image* image = createImage(width, height);
+  bool ok = image != nullptr && loadImage(name, image, range);
+  deleteImage(image);
+  remove(name.c_str());
+  return ok;
+}
+
+static void expect(bool passed, const string& name) {
+  cout << (passed ? "ok     " : "FAILED ") << name << endl;
+  failures += passed ? 0 : 1;
+}
+
+//one 16-bit P6 pixel, big-endian samples
+static string rgb16(int r, int g, int b) {
+  string bytes;
+  for (int sample : { r, g, b }) {
+    bytes += static_cast<char>(sample >> 8);
+    bytes += static_cast<char>(sample & 0xFF);
+  }
+  return bytes;
+}
+
+//width x height of content: "noise" (pseudo-random), "ramp" (the same energy almost everywhere,
+//so the seam search is all ties) or "blocks" (flat patches with ties between them). The blue
+//sample of every ramp and block pixel is its column, so a carve that removes other columns
+//gives other pixels
+static Image* testImage(const string& content, int width, int height) {
+  Image* image = createImage(width, height);
+  unsigned state = 12345;
+  for (int row = 0; row < height; ++row) {
+    for (int col = 0; col < width; ++col) {
+      Pixel& pixel = imageRow(image, row)[col];
+      if (content == "noise") {
+        state = state * 1103515245 + 12345;
+        pixel = { static_cast<int>((state >> 8) & 255), static_cast<int>((state >> 16) & 255), static_cast<int>((state >> 24) & 255) };
+      }
+      else if (content == "ramp") {
+        pixel = { col * 7 % 256, row % 256, col % 256 };
+      }
+      else {
+        pixel = { (col / 4 + row / 3) % 2 * 200, (col / 5) * 40 % 256, col % 256 };
+      }
+    }
+  }
+  return image;
+}
+
+static bool sameImage(const Image* a, const Image* b) {
+  if (a->width != b->width || a->height != b->height) {
+    return false;
+  }
+  for (int row = 0; row < a->height; ++row) {
+    for (int col = 0; col < a->width; ++col) {
+      const Pixel& p = imageRow(a, row)[col];
+      const Pixel& q = imageRow(b, row)[col];
+      if (p.r != q.r || p.g != q.g || p.b != q.b) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+//carveVerticalSeams with a context keeps its cost table across seams and only updates it; the
+//reference searches every seam from scratch, with no context to keep anything in
+static bool carveMatchesFullSearch(const string& content, int width, int height, int targetWidth) {
+  Image* carved = testImage(content, width, height);
+  Image* reference = testImage(content, width, height);
+  CarveContext* context = createCarveContext();
+  carveVerticalSeams(carved, targetWidth, context);
+  deleteCarveContext(context);
+
+  EnergyMap* energies = createEnergyMap(reference);
+  int* seam = createSeam(height);
+  while (reference->width > targetWidth) {
+    traceMinVerticalSeam(energies, seam, SEAM_DP, nullptr);
+    removeVerticalSeam(reference, seam, energies);
+  }
+  deleteSeam(seam);
+  deleteEnergyMap(energies);
+
+  bool same = sameImage(carved, reference);
+  deleteImage(carved);
+  deleteImage(reference);
+  return same;
+}
+
+//enough rows that a width-wide image is split across more than one thread
+static int rowsForThreads(int width) {
+  return 4 * (1 << 16) / width + 3;
+}
+
+//greedy retarget and batched carve of content under the given thread count, result in *image
+static Image* carveWithThreads(int threads, int width, int height) {
+  setThreadCount(threads);
+  Image* image = testImage("noise", width, height);
+  retargetImage(image, width - 1, height - 2);
+  carveVerticalSeams(image, max(1, image->width * 2 / 3), 0);
+  setThreadCount(0);
+  return image;
+}
+
+static bool sameEnergies(const EnergyMap* a, const EnergyMap* b) {
+  for (int row = 0; row < a->height; ++row) {
+    const int* p = energyMapRow(a, row);
+    const int* q = energyMapRow(b, row);
+    if (!equal(p, p + a->width, q)) {
+      return false;
+    }
+  }
+  return a->width == b->width && a->height == b->height;
+}
+
+int main() {
+  setVerbose(false);
+
+  expect(loads("test_p3.ppm", "P3 3 1 255\n1 2 3 4 5 6 7 8 9\n", 3, 1), "P3 in range loads");
+  //the fast sample reader used to consume 999 and let the slow one read the next token
+  expect(!loads("test_p3.ppm", "P3 3 1 255\n1 2 3 999 5 6 7 8 9 10\n", 3, 1), "P3 sample over 255 with a spare token is rejected");
+  expect(!loads("test_p3.ppm", "P3 3 1 255\n1 2 3 999 5 6 7 8 9\n", 3, 1), "P3 sample over 255 is rejected");
+  expect(!loads("test_p3.ppm", "P3 1 1 255\n1 2 256\n", 1, 1), "P3 sample of 256 is rejected");
+
+  expect(loads("test_p6.ppm", "P6 1 1 1000\n" + rgb16(1000, 0, 500), 1, 1), "P6 16-bit at maxval loads");
+  //1001 of 1000 rescales to 255 of 255, so only the raw sample shows it is out of range
+  expect(!loads("test_p6.ppm", "P6 1 1 1000\n" + rgb16(1001, 0, 500), 1, 1), "P6 16-bit sample over maxval is rejected");
+  expect(!loads("test_p6.ppm", "P6 1 1 1000\n" + rgb16(0, 1001, 0), 1, 1, 65535), "P6 16-bit sample over maxval is rejected at 16 bits");
+  expect(!loads("test_p6.ppm", string("P6 1 1 100\n") + char(10) + char(101) + char(0), 1, 1), "P6 8-bit sample over maxval is rejected");
+
+  //the P3 writer used to print samples outside 0-maxval as they were
+  {
+    Image* image = createImage(2, 1);
+    imageRow(image, 0)[0] = { 300, -5, 255 };
+    imageRow(image, 0)[1] = { 0, 70000, 12 };
+    bool written = outputImage("test_out.ppm", image, PPM_ASCII, 255);
+    ifstream file("test_out.ppm");
+    string contents((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    expect(written && contents == "P3\n2 1\n255\n255 0 255 0 255 12\n", "P3 output clamps samples to maxval");
+    deleteImage(image);
+    remove("test_out.ppm");
+  }
+
+  //widths and heights under 3 take the cost update's full-recompute path
+  for (const char* content : { "noise", "ramp", "blocks" }) {
+    bool all = true;
+    for (int width : { 1, 2, 3, 4, 5, 8, 17, 40 }) {
+      for (int height : { 1, 2, 3, 4, 9, 30 }) {
+        for (int targetWidth : { 1, max(1, width / 3), width - 1 }) {
+          if (!carveMatchesFullSearch(content, width, height, max(1, targetWidth))) {
+            cout << "  " << content << " " << width << "x" << height << " -> " << targetWidth << " differs" << endl;
+            all = false;
+          }
+        }
+      }
+    }
+    expect(all, "updated cost table carves like a full search every seam (" + string(content) + ")");
+  }
+
+  //odd widths leave a remainder after every split into threads
+  for (int width : { 3, 5, 17, 131 }) {
+    int height = rowsForThreads(width);
+    Image* single = carveWithThreads(1, width, height);
+    Image* several = carveWithThreads(4, width, height);
+    expect(sameImage(single, several), "1 and 4 threads carve the same seams (" + to_string(width) + "x" + to_string(height) + ")");
+    deleteImage(single);
+    deleteImage(several);
+  }
+
+  //the vector backends take whole vectors of columns and finish the row with scalar code
+  EnergyBackend startBackend = energyBackend();
+  for (EnergyBackend backend : { ENERGY_SSE4, ENERGY_AVX2 }) {
+    string name = backend == ENERGY_SSE4 ? "SSE4" : "AVX2";
+    if (!setEnergyBackend(backend)) {
+      cout << "skip   " << name << " energies and carves match the scalar ones (not supported by this CPU)" << endl;
+      continue;
+    }
+    bool all = true;
+    for (int width : { 3, 5, 17, 131 }) {
+      for (const char* content : { "noise", "ramp", "blocks" }) {
+        Image* image = testImage(content, width, 7);
+        setEnergyBackend(ENERGY_SCALAR);
+        EnergyMap* scalar = createEnergyMap(image);
+        setEnergyBackend(backend);
+        EnergyMap* vector = createEnergyMap(image);
+        if (!sameEnergies(scalar, vector)) {
+          cout << "  " << content << " " << width << "x7 differs" << endl;
+          all = false;
+        }
+        //the energy refreshes after every removal go through the backend too
+        Image* scalarCarve = testImage(content, width, 7);
+        Image* vectorCarve = testImage(content, width, 7);
+        setEnergyBackend(ENERGY_SCALAR);
+        retargetImage(scalarCarve, max(1, width / 2), 5);
+        setEnergyBackend(backend);
+        retargetImage(vectorCarve, max(1, width / 2), 5);
+        if (!sameImage(scalarCarve, vectorCarve)) {
+          cout << "  " << content << " " << width << "x7 carves differently" << endl;
+          all = false;
+        }
+        deleteImage(scalarCarve);
+        deleteImage(vectorCarve);
+        deleteEnergyMap(scalar);
+        deleteEnergyMap(vector);
+        deleteImage(image);
+      }
+    }
+    expect(all, name + " energies and carves match the scalar ones");
+  }
+  setEnergyBackend(startBackend);
+
+  //a write that stops partway must not leave a truncated file: a file size limit makes every
+  //write past the first 64 bytes fail (with SIGXFSZ ignored, which would end the process)
+  {
+    Image* image = testImage("noise", 64, 64);
+    rlimit limit;
+    getrlimit(RLIMIT_FSIZE, &limit);
+    rlimit small = limit;
+    small.rlim_cur = 64;
+    signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &small);
+    bool written = outputImage("truncated.ppm", image);
+    setrlimit(RLIMIT_FSIZE, &limit);
+    signal(SIGXFSZ, SIG_DFL);
+    expect(!written && !ifstream("truncated.ppm"), "failed output leaves no partial file");
+    remove("truncated.ppm");
+    deleteImage(image);
+  }
+
+  //a context that has carved an image once in each direction must carve it again without
+  //touching the heap. Only counted with -DSEAM_COUNT_ALLOCATIONS
+  if (heapAllocations() < 0) {
+    cout << "skip   second carve with a context allocates nothing (build with -DSEAM_COUNT_ALLOCATIONS)" << endl;
+  }
+  else {
+    Image* original = testImage("noise", 120, 90);
+    Image* image = createImage(120, 90);
+    CarveContext* context = createCarveContext();
+    //warm up: one carve of each direction, since a vertical one doesn't size the transposed copy
+    copyImage(original, image);
+    carveVerticalSeams(image, 100, context);
+    copyImage(original, image);
+    carveHorizontalSeams(image, 70, context);
+    long long before = heapAllocations();
+    copyImage(original, image);
+    carveVerticalSeams(image, 100, context);
+    copyImage(original, image);
+    carveHorizontalSeams(image, 70, context);
+    long long allocations = heapAllocations() - before;
+    if (allocations != 0) {
+      cout << "  " << allocations << " allocations" << endl;
+    }
+    expect(allocations == 0, "second carve with a context allocates nothing");
+    deleteCarveContext(context);
+    deleteImage(image);
+    deleteImage(original);
+  }
+
+  cout << (failures == 0 ? "all passed" : to_string(failures) + " failed") << endl;
+  return failures == 0 ? 0 : 1;
+}